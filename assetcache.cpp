@@ -0,0 +1,177 @@
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "tgaimage.h"
+#include "assetcache.h"
+
+AssetCacheStats::AssetCacheStats() : hits(0), misses(0), sharedLoads(0), evictions(0), reloads(0), bytes(0), budget(0), entries(0) {
+}
+
+std::string AssetCacheStats::toJson() const {
+	std::ostringstream json;
+	json << "{\"hits\": " << hits << ", \"misses\": " << misses << ", \"shared_loads\": " << sharedLoads
+		<< ", \"evictions\": " << evictions << ", \"reloads\": " << reloads << ", \"entries\": " << entries
+		<< ", \"bytes\": " << bytes << ", \"budget\": " << budget << "}";
+	return json.str();
+}
+
+AssetCache::AssetCache(size_t budgetBytes, bool useMeshCache, bool optimizeMeshes) : budget(budgetBytes), useMeshCache(useMeshCache), optimizeMeshes(optimizeMeshes) {
+}
+
+AssetCache::~AssetCache() {
+	// Whoever still holds an asset keeps it alive, only the entries go away here
+	lru.clear();
+	entries.clear();
+}
+
+std::shared_ptr<Model> AssetCache::getModel(const std::string &path, bool *hit) {
+	std::shared_ptr<Entry> entry = acquire(MODEL_ASSET, path, hit);
+	return entry ? entry->model : std::shared_ptr<Model>();
+}
+
+std::shared_ptr<Texture> AssetCache::getTexture(const std::string &path, bool *hit) {
+	std::shared_ptr<Entry> entry = acquire(TEXTURE_ASSET, path, hit);
+	return entry ? entry->texture : std::shared_ptr<Texture>();
+}
+
+std::shared_ptr<AssetCache::Entry> AssetCache::acquire(AssetType type, const std::string &path, bool *hit) {
+	std::string key = (type == MODEL_ASSET ? "model:" : "texture:") + path;
+	// A file that can't be stated is still tried, a model can come from its .srmesh alone
+	time_t modified = 0;
+	long long fileSize = -1;
+	struct stat info;
+	if (stat(path.c_str(), &info) == 0) {
+		modified = info.st_mtime;
+		fileSize = (long long)info.st_size;
+	}
+	if (hit != NULL) {
+		*hit = false;
+	}
+
+	std::unique_lock<std::mutex> guard(lock);
+	std::map<std::string, std::shared_ptr<Entry> >::iterator found = entries.find(key);
+	if (found != entries.end()) {
+		std::shared_ptr<Entry> entry = found->second;
+		if (entry->loading) {
+			// Whatever is being loaded is taken even if the file changed meanwhile, the next request will see it
+			stats.sharedLoads++;
+			loadFinished.wait(guard, [&entry] { return !entry->loading; });
+			if (!entry->model && !entry->texture) {
+				return std::shared_ptr<Entry>();
+			}
+			if (hit != NULL) {
+				*hit = true;
+			}
+			return entry;
+		}
+		if (entry->modified == modified && entry->fileSize == fileSize) {
+			stats.hits++;
+			lru.splice(lru.begin(), lru, entry->lruPosition);
+			if (hit != NULL) {
+				*hit = true;
+			}
+			return entry;
+		}
+		// Changed on disk, anyone still using the old asset keeps their copy
+		stats.reloads++;
+		removeEntry(*entry);
+	}
+
+	std::shared_ptr<Entry> entry(new Entry());
+	entry->type = type;
+	entry->key = key;
+	entry->modified = modified;
+	entry->fileSize = fileSize;
+	entry->loading = true;
+	entry->bytes = 0;
+	entries[key] = entry;
+	stats.misses++;
+
+	guard.unlock();
+	load(*entry, path);
+	guard.lock();
+
+	entry->loading = false;
+	bool loaded = entry->model || entry->texture;
+	if (loaded) {
+		lru.push_front(entry.get());
+		entry->lruPosition = lru.begin();
+		stats.bytes += entry->bytes;
+		evictOverBudget(entry.get());
+	} else {
+		// Not kept, the file may show up for a later request
+		entries.erase(key);
+	}
+	guard.unlock();
+	loadFinished.notify_all();
+	if (!loaded) {
+		return std::shared_ptr<Entry>();
+	}
+	return entry;
+}
+
+void AssetCache::load(Entry &entry, const std::string &path) {
+	if (entry.type == MODEL_ASSET) {
+		std::shared_ptr<Model> loaded(new Model(path.c_str(), useMeshCache, optimizeMeshes));
+		if (loaded->getTotalFaces() > 0) {
+			entry.model = loaded;
+			entry.bytes = loaded->getMemoryUsage();
+		}
+	} else {
+		TGAImage image;
+		if (image.read_tga_file(path.c_str())) {
+			image.flip_vertically();
+			entry.texture.reset(new Texture(image));
+			entry.bytes = entry.texture->getMemoryUsage();
+		}
+	}
+}
+
+bool AssetCache::isInUse(const Entry &entry) const {
+	// The entry holds one reference, anything above that is someone rendering with it
+	return entry.model.use_count() > 1 || entry.texture.use_count() > 1;
+}
+
+void AssetCache::removeEntry(Entry &entry) {
+	lru.erase(entry.lruPosition);
+	stats.bytes -= entry.bytes;
+	// Last reference to the entry when nobody else holds it, don't touch it after this
+	entries.erase(entry.key);
+}
+
+void AssetCache::evictOverBudget(const Entry *keep) {
+	std::list<Entry*>::iterator it = lru.end();
+	while (stats.bytes > budget && it != lru.begin()) {
+		--it;
+		Entry *entry = *it;
+		if (entry == keep || isInUse(*entry)) {
+			continue;
+		}
+		// it moves past the entry before it is erased
+		++it;
+		removeEntry(*entry);
+		stats.evictions++;
+	}
+}
+
+void AssetCache::setBudget(size_t budgetBytes) {
+	std::lock_guard<std::mutex> guard(lock);
+	budget = budgetBytes;
+	evictOverBudget(NULL);
+}
+
+void AssetCache::clear() {
+	std::lock_guard<std::mutex> guard(lock);
+	size_t savedBudget = budget;
+	budget = 0;
+	evictOverBudget(NULL);
+	budget = savedBudget;
+}
+
+AssetCacheStats AssetCache::getStats() const {
+	std::lock_guard<std::mutex> guard(lock);
+	AssetCacheStats current = stats;
+	current.budget = budget;
+	current.entries = (int)lru.size();
+	return current;
+}
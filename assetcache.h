@@ -0,0 +1,88 @@
+#ifndef __ASSETCACHE_H__
+#define __ASSETCACHE_H__
+
+#include <condition_variable>
+#include <ctime>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "model.h"
+#include "texture.h"
+
+// Running totals of an AssetCache since it was created
+struct AssetCacheStats {
+	long long hits;
+	long long misses;
+	long long sharedLoads;    // requests that waited for a load someone else had already started
+	long long evictions;
+	long long reloads;        // entries dropped because the file changed on disk
+	size_t bytes;             // memory held by the entries now
+	size_t budget;
+	int entries;
+
+	AssetCacheStats();
+	// A single line JSON object
+	std::string toJson() const;
+};
+
+// Parsed models and decoded textures shared by everyone asking for the same file.
+// Entries are keyed by path and modification time, so a file changed on disk is loaded again.
+// The assets are handed out as shared_ptr: an entry still held by someone is never evicted, the
+// others go in least recently used order whenever the total goes over the memory budget.
+// A budget smaller than the assets in use is only exceeded until they are released.
+// Safe to call from several threads, concurrent requests for a file that is being loaded
+// wait for that load instead of starting their own
+class AssetCache {
+private:
+	enum AssetType { MODEL_ASSET, TEXTURE_ASSET };
+	struct Entry {
+		AssetType type;
+		std::string key;
+		time_t modified;
+		long long fileSize;
+		bool loading;
+		std::shared_ptr<Model> model;
+		std::shared_ptr<Texture> texture;
+		size_t bytes;
+		std::list<Entry*>::iterator lruPosition;
+	};
+
+	size_t budget;
+	bool useMeshCache;
+	bool optimizeMeshes;
+	mutable std::mutex lock;
+	std::condition_variable loadFinished;
+	std::map<std::string, std::shared_ptr<Entry> > entries;
+	// Loaded entries, the most recently used first
+	std::list<Entry*> lru;
+	AssetCacheStats stats;
+
+	AssetCache(const AssetCache &);
+	AssetCache & operator =(const AssetCache &);
+
+	// Returns the entry with the asset loaded, or NULL when it can't be loaded
+	std::shared_ptr<Entry> acquire(AssetType type, const std::string &path, bool *hit);
+	void load(Entry &entry, const std::string &path);
+	bool isInUse(const Entry &entry) const;
+	void removeEntry(Entry &entry);
+	// Called with the lock held. Evicts least recently used entries nobody holds, except keep
+	void evictOverBudget(const Entry *keep);
+public:
+	// useMeshCache and optimizeMeshes are passed to the Model constructor
+	AssetCache(size_t budgetBytes, bool useMeshCache=true, bool optimizeMeshes=false);
+	~AssetCache();
+
+	// NULL when the file can't be loaded. hit, when given, tells if it was already in memory or being loaded
+	std::shared_ptr<Model> getModel(const std::string &path, bool *hit=NULL);
+	// Flipped so v goes up as in the OBJ texture coordinates
+	std::shared_ptr<Texture> getTexture(const std::string &path, bool *hit=NULL);
+
+	void setBudget(size_t budgetBytes);
+	// Evicts everything not in use
+	void clear();
+	AssetCacheStats getStats() const;
+};
+
+#endif //__ASSETCACHE_H__
@@ -0,0 +1,42 @@
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "benchmark.h"
+
+volatile float benchmarkSink = 0;
+
+void BenchmarkReport::add(const std::string &group, const std::string &name, double milliseconds, long long items, long long bytes) {
+	BenchmarkResult result = { group, name, milliseconds, items, bytes };
+	results.push_back(result);
+
+	std::cout << std::fixed << std::setprecision(3) << group << " " << name << " " << milliseconds << " ms";
+	if (items > 0) {
+		std::cout << " " << items << " items " << std::setprecision(2) << milliseconds * 1e6 / items << " ns/item";
+	}
+	if (bytes > 0) {
+		std::cout << " " << bytes << " bytes " << std::setprecision(1) << bytes / (milliseconds * 1e3) << " MB/s";
+	}
+	std::cout << std::endl;
+}
+
+bool BenchmarkReport::writeJson(const char *filename, bool passed) const {
+	std::ofstream out(filename);
+	if (!out.is_open()) {
+		std::cerr << "can't open file " << filename << "\n";
+		return false;
+	}
+	out << std::setprecision(6);
+	out << "{\n  \"timestamp\": " << (long long)time(NULL) << ",\n  \"passed\": " << (passed ? "true" : "false") << ",\n  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult &result = results[i];
+		out << "    {\"group\": \"" << result.group << "\", \"name\": \"" << result.name << "\", \"best_ms\": " << result.milliseconds
+			<< ", \"items\": " << result.items << ", \"bytes\": " << result.bytes;
+		if (result.items > 0) {
+			out << ", \"ns_per_item\": " << result.milliseconds * 1e6 / result.items;
+		}
+		out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+	return out.good();
+}
@@ -0,0 +1,65 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Wall clock time of the fastest of runs calls to f, in milliseconds.
+// The fastest run is the one least disturbed by the rest of the machine
+template <class F>
+double measureBestMilliseconds(int runs, F f) {
+	double best = 0;
+	for (int i = 0; i < runs; i++) {
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		f();
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (i == 0 || elapsed.count() < best) {
+			best = elapsed.count();
+		}
+	}
+	return best;
+}
+
+// Results of the micro benchmarks are added here so the compiler can't drop the work as unused
+extern volatile float benchmarkSink;
+
+struct BenchmarkOptions {
+	// Smaller inputs and fewer runs, to check that everything still works
+	bool quick;
+	const char *modelPath;
+	const char *texturePath;
+	// Faces of the generated mesh the OBJ loader is measured on
+	long long syntheticFaces;
+
+	BenchmarkOptions() : quick(false), modelPath("obj/head.obj"), texturePath("obj/head_diffuse.tga"), syntheticFaces(10000000) {
+	}
+};
+
+// One measured case: the best time of a run and how much work a run does, in items
+// (calls, pixels, faces...) and bytes. Either can be 0 when it means nothing for the case
+struct BenchmarkResult {
+	std::string group;
+	std::string name;
+	double milliseconds;
+	long long items;
+	long long bytes;
+};
+
+// Every result is printed as it comes, and the whole list can be saved as JSON to compare runs
+class BenchmarkReport {
+private:
+	std::vector<BenchmarkResult> results;
+public:
+	void add(const std::string &group, const std::string &name, double milliseconds, long long items=0, long long bytes=0);
+	bool writeJson(const char *filename, bool passed) const;
+};
+
+// Every group of benchmarks returns false when a result didn't match its reference
+bool runMathBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options);
+bool runRasterBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options);
+bool runTgaBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options);
+bool runModelBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options);
+bool runFrameBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options);
+
+#endif //__BENCHMARK_H__
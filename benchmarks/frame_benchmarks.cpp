@@ -0,0 +1,80 @@
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "tgaimage.h"
+#include "renderer.h"
+#include "benchmark.h"
+
+// Whole frames of the default scene: clear, vertex transform, rasterization with the textured
+// shader and the TGA encoding, with the same thread pool and HiZ setup as the renderer
+bool runFrameBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options) {
+	struct Resolution { const char *name; int width; int height; int runs; };
+	const Resolution resolutions[] = {
+		{ "800x800", 800, 800, 15 },
+		{ "1080p", 1920, 1080, 9 },
+		{ "4K", 3840, 2160, 5 },
+	};
+	int totalResolutions = options.quick ? 1 : (int)(sizeof(resolutions) / sizeof(resolutions[0]));
+
+	model = new Model(options.modelPath);
+	TGAImage diffuseImage;
+	if (diffuseImage.read_tga_file(options.texturePath)) {
+		diffuseImage.flip_vertically();
+		diffuseTexture = new Texture(diffuseImage);
+	}
+	renderWorkers = new ThreadPool();
+	hiZBuffer = new HiZBuffer(resolutions[0].width, resolutions[0].height);
+
+	bool passed = model->getTotalFaces() > 0;
+	for (int i = 0; i < totalResolutions; i++) {
+		const Resolution &resolution = resolutions[i];
+		int runs = options.quick ? 2 : resolution.runs;
+		std::string size = resolution.name;
+		long long pixels = (long long)resolution.width * resolution.height;
+		setResolution(resolution.width, resolution.height);
+		Framebuffer framebuffer(resolution.width, resolution.height);
+
+		double drawMs = measureBestMilliseconds(runs, [&]() {
+			clearFrame(framebuffer);
+			drawObjModel(framebuffer, diffuseTexture, SHADING_TEXTURE, false);
+		});
+		std::vector<unsigned char> file;
+		double encodeMs = measureBestMilliseconds(runs, [&]() {
+			TGAImage image(resolution.width, resolution.height, TGAImage::RGB);
+			framebuffer.writeToImage(image);
+			image.flip_vertically();
+			file.clear();
+			image.encode(TGAImage::TGA_FILE, file, renderWorkers);
+		});
+		double frameMs = measureBestMilliseconds(runs, [&]() {
+			clearFrame(framebuffer);
+			drawObjModel(framebuffer, diffuseTexture, SHADING_TEXTURE, false);
+			TGAImage image(resolution.width, resolution.height, TGAImage::RGB);
+			framebuffer.writeToImage(image);
+			image.flip_vertically();
+			file.clear();
+			image.encode(TGAImage::TGA_FILE, file, renderWorkers);
+		});
+		report.add("frame", "draw_" + size, drawMs, pixels);
+		report.add("frame", "encode_tga_" + size, encodeMs, pixels, file.size());
+		report.add("frame", "total_" + size, frameMs, pixels, file.size());
+
+		// the head covers a good part of the screen, an empty frame means the pipeline is broken
+		long long covered = 0;
+		for (long long p = 0; p < pixels; p++) {
+			covered += zBuffer[p] != -std::numeric_limits<float>::max();
+		}
+		passed = passed && covered > pixels / 20;
+	}
+
+	delete hiZBuffer;
+	hiZBuffer = NULL;
+	delete renderWorkers;
+	renderWorkers = NULL;
+	delete diffuseTexture;
+	diffuseTexture = NULL;
+	delete model;
+	model = NULL;
+	return passed;
+}
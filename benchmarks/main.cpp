@@ -0,0 +1,45 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "benchmark.h"
+
+// Runs every group of benchmarks from the repository root (the OBJ and texture paths are relative to it).
+//   --quick                 small inputs and few runs
+//   --json=<file>           where the results go, benchmark_results.json by default
+//   --faces=<n>             faces of the generated mesh for the OBJ loader, 10M by default
+//   --model=<obj>           model for the loader and frame benchmarks, obj/head.obj by default
+int main(int argc, char** argv) {
+	BenchmarkOptions options;
+	std::string jsonPath = "benchmark_results.json";
+	long long syntheticFaces = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string argument(argv[i]);
+		if (argument == "--quick") {
+			options.quick = true;
+		} else if (argument.compare(0, 7, "--json=") == 0) {
+			jsonPath = argument.substr(7);
+		} else if (argument.compare(0, 8, "--faces=") == 0) {
+			syntheticFaces = std::atoll(argument.c_str() + 8);
+		} else if (argument.compare(0, 8, "--model=") == 0) {
+			options.modelPath = argv[i] + 8;
+		}
+	}
+	if (syntheticFaces > 0) {
+		options.syntheticFaces = syntheticFaces;
+	} else if (options.quick) {
+		options.syntheticFaces = 200000;
+	}
+
+	BenchmarkReport report;
+	bool passed = runMathBenchmarks(report, options);
+	passed = runRasterBenchmarks(report, options) && passed;
+	passed = runTgaBenchmarks(report, options) && passed;
+	passed = runModelBenchmarks(report, options) && passed;
+	passed = runFrameBenchmarks(report, options) && passed;
+	report.writeJson(jsonPath.c_str(), passed);
+
+	if (!passed) {
+		std::cerr << "# some benchmark results didn't match their reference" << std::endl;
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include "geometry.h"
+#include "benchmark.h"
+
+static Mat4f makeRandomMatrix(std::mt19937 &random) {
+	std::uniform_real_distribution<float> value(-1.f, 1.f);
+	Mat4f matrix;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			matrix[i][j] = value(random);
+		}
+	}
+	// well away from singular, so inverse() is measured on the usual path
+	for (int i = 0; i < 4; i++) {
+		matrix[i][i] += 4.f;
+	}
+	return matrix;
+}
+
+// The heap backed Matrix against the fixed size Mat4f the vertex path uses
+bool runMathBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options) {
+	std::mt19937 random(42);
+	const int runs = options.quick ? 2 : 7;
+	const int products = options.quick ? 10000 : 200000;
+	const int points = options.quick ? 100000 : 2000000;
+
+	Mat4f a = makeRandomMatrix(random);
+	Mat4f b = makeRandomMatrix(random);
+	Matrix matrixA = a.toMatrix();
+	Matrix matrixB = b.toMatrix();
+
+	double matrixProductMs = measureBestMilliseconds(runs, [&]() {
+		float sum = 0;
+		for (int i = 0; i < products; i++) {
+			Matrix product = matrixA * matrixB;
+			sum += product[i & 3][0];
+		}
+		benchmarkSink += sum;
+	});
+	report.add("math", "matrix_multiply", matrixProductMs, products);
+
+	double matrixInverseMs = measureBestMilliseconds(runs, [&]() {
+		float sum = 0;
+		for (int i = 0; i < products; i++) {
+			Matrix inverse = matrixA.inverse();
+			sum += inverse[i & 3][0];
+		}
+		benchmarkSink += sum;
+	});
+	report.add("math", "matrix_inverse", matrixInverseMs, products);
+
+	double mat4ProductMs = measureBestMilliseconds(runs, [&]() {
+		float sum = 0;
+		for (int i = 0; i < products; i++) {
+			Mat4f product = a * b;
+			sum += product[i & 3][0];
+		}
+		benchmarkSink += sum;
+	});
+	report.add("math", "mat4f_multiply", mat4ProductMs, products);
+
+	// The same check for both types, a Matrix inverse times the matrix has to be the identity
+	Matrix identity = matrixA * matrixA.inverse();
+	bool passed = true;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			passed = passed && std::abs(identity[i][j] - (i == j ? 1.f : 0.f)) < 1e-4f;
+		}
+	}
+
+	std::uniform_real_distribution<float> coordinate(-1.f, 1.f);
+	std::vector<Vec3f> input(points), output(points);
+	for (int i = 0; i < points; i++) {
+		input[i] = Vec3f(coordinate(random), coordinate(random), coordinate(random));
+	}
+	double transformPointMs = measureBestMilliseconds(runs, [&]() {
+		for (int i = 0; i < points; i++) {
+			output[i] = a.transformPoint(input[i]);
+		}
+		benchmarkSink += output[points - 1].x;
+	});
+	report.add("math", "mat4f_transform_point", transformPointMs, points);
+
+	std::vector<Vec3f> batchOutput(points);
+	double transformBatchMs = measureBestMilliseconds(runs, [&]() {
+		a.transformBatch(input.data(), batchOutput.data(), points);
+		benchmarkSink += batchOutput[points - 1].x;
+	});
+	report.add("math", "mat4f_transform_batch", transformBatchMs, points);
+
+	for (int i = 0; i < points && passed; i++) {
+		Vec3f difference = output[i] - batchOutput[i];
+		passed = std::abs(difference.x) + std::abs(difference.y) + std::abs(difference.z) <= 1e-4f * (1.f + std::abs(output[i].x) + std::abs(output[i].y) + std::abs(output[i].z));
+	}
+	return passed;
+}
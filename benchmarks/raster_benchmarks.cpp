@@ -0,0 +1,90 @@
+#include <random>
+#include <string>
+#include <vector>
+#include "geometry.h"
+#include "framebuffer.h"
+#include "renderer.h"
+#include "benchmark.h"
+
+// Draws the triangle count times through the rasterizer in mode, every copy a bit nearer than
+// the previous one so all of them pass the depth test and write their pixels
+static double measureTriangle(const Vec3f *shape, int count, int runs, RasterizerMode mode, Framebuffer &framebuffer) {
+	rasterizerMode = mode;
+	double milliseconds = measureBestMilliseconds(runs, [&]() {
+		clearFrame(framebuffer);
+		for (int i = 0; i < count; i++) {
+			Vec3f triangle[3];
+			for (int j = 0; j < 3; j++) {
+				triangle[j] = Vec3f(shape[j].x, shape[j].y, (float)i);
+			}
+			drawScreenTriangle(triangle, PackedColor(255, 255, 255, 255), framebuffer);
+		}
+	});
+	rasterizerMode = RASTERIZER_EDGE_FUNCTION;
+	return milliseconds;
+}
+
+bool runRasterBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options) {
+	std::mt19937 random(7);
+	const int runs = options.quick ? 2 : 7;
+	const int width = 800, height = 800;
+	setResolution(width, height);
+	Framebuffer framebuffer(width, height);
+	clearFrame(framebuffer);
+
+	// Barycentric weights of random pixels of the bounding box of a large triangle
+	const Vec3f large[3] = { Vec3f(50, 60, 0), Vec3f(750, 120, 0), Vec3f(300, 740, 0) };
+	const int points = options.quick ? 100000 : 2000000;
+	std::uniform_int_distribution<int> pixel(0, width - 1);
+	std::vector<Vec3f> samples(points);
+	for (int i = 0; i < points; i++) {
+		samples[i] = Vec3f((float)pixel(random), (float)pixel(random), 0);
+	}
+	double barycentricMs = measureBestMilliseconds(runs, [&]() {
+		float sum = 0;
+		for (int i = 0; i < points; i++) {
+			sum += getBarycentricVector(large, samples[i]).x;
+		}
+		benchmarkSink += sum;
+	});
+	report.add("raster", "barycentric_vector", barycentricMs, points);
+
+	// The triangles are named after their shape, small and sliver ones are mostly setup cost
+	struct Shape { const char *name; Vec3f vertex[3]; int count; };
+	const Shape shapes[] = {
+		{ "small", { Vec3f(100, 100, 0), Vec3f(108, 101, 0), Vec3f(103, 107, 0) }, 20000 },
+		{ "large", { Vec3f(50, 60, 0), Vec3f(750, 120, 0), Vec3f(300, 740, 0) }, 100 },
+		{ "sliver", { Vec3f(20, 30, 0), Vec3f(780, 770, 0), Vec3f(22, 33, 0) }, 2000 },
+	};
+	for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+		int count = options.quick ? shapes[i].count / 10 : shapes[i].count;
+		double edgeMs = measureTriangle(shapes[i].vertex, count, runs, RASTERIZER_EDGE_FUNCTION, framebuffer);
+		double barycentricTriangleMs = measureTriangle(shapes[i].vertex, count, runs, RASTERIZER_BARYCENTRIC, framebuffer);
+		report.add("raster", std::string("triangle_edge_") + shapes[i].name, edgeMs, count);
+		report.add("raster", std::string("triangle_barycentric_") + shapes[i].name, barycentricTriangleMs, count);
+	}
+
+	// Bresenham lines, mostly flat and mostly steep ones across the screen
+	const int lines = options.quick ? 2000 : 20000;
+	std::vector<Vec2i> ends(lines * 2);
+	for (int i = 0; i < lines * 2; i++) {
+		ends[i] = Vec2i(pixel(random), pixel(random));
+	}
+	double lineMs = measureBestMilliseconds(runs, [&]() {
+		size_t points = 0;
+		for (int i = 0; i < lines; i++) {
+			points += drawLine(ends[2 * i].x, ends[2 * i].y, ends[2 * i + 1].x, ends[2 * i + 1].y, framebuffer, PackedColor(255, 0, 0, 255)).size();
+		}
+		benchmarkSink += (float)points;
+	});
+	report.add("raster", "draw_line", lineMs, lines);
+
+	// Something has to have been drawn by the last triangles and lines
+	bool passed = false;
+	for (int y = 0; y < height && !passed; y++) {
+		for (int x = 0; x < width && !passed; x++) {
+			passed = framebuffer.getRow(y)[x].val != PackedColor(0, 0, 0, 255).val;
+		}
+	}
+	return passed;
+}
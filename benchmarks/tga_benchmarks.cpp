@@ -0,0 +1,223 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "tgaimage.h"
+#include "benchmark.h"
+
+// The RLE encoder TGAImage::write_tga_file used before it went parallel, stream calls per chunk
+// and pixels compared byte by byte. Kept here as the reference for speed and output
+static bool legacyUnloadRleData(TGAImage &image, std::ofstream &out) {
+	const unsigned char max_chunk_length = 128;
+	unsigned char *data = image.buffer();
+	int bytespp = image.get_bytespp();
+	unsigned long npixels = image.get_width()*image.get_height();
+	unsigned long curpix = 0;
+	while (curpix<npixels) {
+		unsigned long chunkstart = curpix*bytespp;
+		unsigned long curbyte = curpix*bytespp;
+		unsigned char run_length = 1;
+		bool raw = true;
+		while (curpix+run_length<npixels && run_length<max_chunk_length) {
+			bool succ_eq = true;
+			for (int t=0; succ_eq && t<bytespp; t++) {
+				succ_eq = (data[curbyte+t]==data[curbyte+t+bytespp]);
+			}
+			curbyte += bytespp;
+			if (1==run_length) {
+				raw = !succ_eq;
+			}
+			if (raw && succ_eq) {
+				run_length--;
+				break;
+			}
+			if (!raw && !succ_eq) {
+				break;
+			}
+			run_length++;
+		}
+		curpix += run_length;
+		out.put(raw?run_length-1:run_length+127);
+		out.write((char *)(data+chunkstart), (raw?run_length*bytespp:bytespp));
+	}
+	return out.good();
+}
+
+static bool legacyWriteTgaFile(TGAImage &image, const char *filename) {
+	unsigned char areas_ref[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	unsigned char footer[18] = {'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
+	std::ofstream out(filename, std::ios::binary);
+	TGA_Header header;
+	memset((void *)&header, 0, sizeof(header));
+	header.bitsperpixel = image.get_bytespp()<<3;
+	header.width = image.get_width();
+	header.height = image.get_height();
+	header.datatypecode = image.get_bytespp()==TGAImage::GRAYSCALE ? 11 : 10;
+	header.imagedescriptor = 0x20;
+	out.write((char *)&header, sizeof(header));
+	legacyUnloadRleData(image, out);
+	out.write((char *)areas_ref, sizeof(areas_ref));
+	out.write((char *)footer, sizeof(footer));
+	return out.good();
+}
+
+// The decoder TGAImage::read_tga_file used before it decoded from memory, a stream call per chunk
+// header and per raw pixel. Only what the benchmark files need: RLE, top-left origin, no image id
+static bool legacyReadTgaFile(TGAImage &image, const char *filename) {
+	std::ifstream in(filename, std::ios::binary);
+	TGA_Header header;
+	in.read((char *)&header, sizeof(header));
+	if (!in.good()) {
+		return false;
+	}
+	int bytespp = header.bitsperpixel>>3;
+	image = TGAImage(header.width, header.height, bytespp);
+	unsigned char *data = image.buffer();
+	unsigned long pixelcount = header.width*header.height;
+	unsigned long currentpixel = 0;
+	unsigned long currentbyte = 0;
+	TGAColor colorbuffer;
+	do {
+		unsigned char chunkheader = in.get();
+		if (!in.good()) {
+			return false;
+		}
+		if (chunkheader<128) {
+			chunkheader++;
+			for (int i=0; i<chunkheader; i++) {
+				in.read((char *)colorbuffer.raw, bytespp);
+				for (int t=0; t<bytespp; t++)
+					data[currentbyte++] = colorbuffer.raw[t];
+				currentpixel++;
+			}
+		} else {
+			chunkheader -= 127;
+			in.read((char *)colorbuffer.raw, bytespp);
+			for (int i=0; i<chunkheader; i++) {
+				for (int t=0; t<bytespp; t++)
+					data[currentbyte++] = colorbuffer.raw[t];
+				currentpixel++;
+			}
+		}
+		if (!in.good() || currentpixel>pixelcount) {
+			return false;
+		}
+	} while (currentpixel<pixelcount);
+	return true;
+}
+
+// Something close to what the renderer writes: a black background around a lit, textured blob,
+// smooth shading with some noise on top so it has both long runs and raw stretches
+static TGAImage makeRenderLikeImage(int width, int height, unsigned int seed) {
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<int> noise(0, 7);
+	TGAImage image(width, height, TGAImage::RGB);
+	float cx = width * .5f, cy = height * .5f;
+	float rx = width * .3f, ry = height * .4f;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float dx = (x - cx) / rx, dy = (y - cy) / ry;
+			float d = dx*dx + dy*dy;
+			if (d > 1.f) {
+				continue;
+			}
+			float intensity = 1.f - d;
+			int n = noise(random);
+			image.set(x, y, TGAColor((unsigned char)(120 * intensity + n), (unsigned char)(90 * intensity + n), (unsigned char)(70 * intensity), 255));
+		}
+	}
+	return image;
+}
+
+static long fileSize(const char *filename) {
+	std::ifstream in(filename, std::ios::binary | std::ios::ate);
+	return in.is_open() ? (long)in.tellg() : -1;
+}
+
+bool runTgaBenchmarks(BenchmarkReport &report, const BenchmarkOptions &options) {
+	struct Resolution { const char *name; int width; int height; int runs; };
+	const Resolution resolutions[] = {
+		{ "800x800", 800, 800, 9 },
+		{ "4K", 3840, 2160, 5 },
+		{ "8K", 7680, 4320, 3 },
+	};
+	int totalResolutions = options.quick ? 1 : (int)(sizeof(resolutions) / sizeof(resolutions[0]));
+	const char *legacyFile = "benchmark_legacy.tga";
+	const char *currentFile = "benchmark_current.tga";
+	// the RLE bands of the current encoder are spread across it
+	ThreadPool encodeWorkers;
+	bool passed = true;
+	for (int i = 0; i < totalResolutions; i++) {
+		const Resolution &resolution = resolutions[i];
+		int runs = options.quick ? 2 : resolution.runs;
+		std::string size = resolution.name;
+		TGAImage image = makeRenderLikeImage(resolution.width, resolution.height, 1234);
+		long long pixels = (long long)resolution.width * resolution.height;
+		double legacyMs = measureBestMilliseconds(runs, [&]() { legacyWriteTgaFile(image, legacyFile); });
+		double currentMs = measureBestMilliseconds(runs, [&]() { image.write_tga_file(currentFile, true, &encodeWorkers); });
+
+		// Both files have to decode to the same pixels, the packets only differ at band boundaries
+		TGAImage legacyImage, currentImage;
+		bool same = legacyImage.read_tga_file(legacyFile) && currentImage.read_tga_file(currentFile)
+			&& memcmp(legacyImage.buffer(), image.buffer(), resolution.width * resolution.height * image.get_bytespp()) == 0
+			&& memcmp(currentImage.buffer(), image.buffer(), resolution.width * resolution.height * image.get_bytespp()) == 0;
+		passed = passed && same;
+		report.add("tga", "rle_write_legacy_" + size, legacyMs, pixels, fileSize(legacyFile));
+		report.add("tga", "rle_write_" + size, currentMs, pixels, fileSize(currentFile));
+		if (!same) {
+			std::cerr << "# tga rle write " << size << " MISMATCH" << std::endl;
+		}
+
+		// Reading back, against copying the same number of bytes as the file in memory
+		std::vector<unsigned char> fileCopy(fileSize(currentFile)), fileCopyTarget(fileCopy.size());
+		double memcpyMs = measureBestMilliseconds(runs, [&]() { memcpy(fileCopyTarget.data(), fileCopy.data(), fileCopy.size()); });
+		double legacyReadMs = measureBestMilliseconds(runs, [&]() { legacyReadTgaFile(legacyImage, currentFile); });
+		double currentReadMs = measureBestMilliseconds(runs, [&]() { currentImage.read_tga_file(currentFile); });
+		bool sameRead = memcmp(legacyImage.buffer(), image.buffer(), resolution.width * resolution.height * image.get_bytespp()) == 0
+			&& memcmp(currentImage.buffer(), image.buffer(), resolution.width * resolution.height * image.get_bytespp()) == 0;
+		passed = passed && sameRead;
+		report.add("tga", "rle_read_legacy_" + size, legacyReadMs, pixels, fileCopy.size());
+		report.add("tga", "rle_read_" + size, currentReadMs, pixels, fileCopy.size());
+		report.add("tga", "memcpy_" + size, memcpyMs, 0, fileCopy.size());
+		if (!sameRead) {
+			std::cerr << "# tga rle read " << size << " MISMATCH" << std::endl;
+		}
+
+		// Encoding alone in every output format, the file write is the same single write for all of them
+		const TGAImage::FileFormat formats[] = { TGAImage::TGA_FILE, TGAImage::QOI_FILE, TGAImage::PPM_FILE, TGAImage::PAM_FILE };
+		for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+			std::vector<unsigned char> encoded;
+			double encodeMs = measureBestMilliseconds(runs, [&]() { encoded.clear(); image.encode(formats[f], encoded, &encodeWorkers); });
+			report.add("tga", std::string("encode_") + TGAImage::format_extension(formats[f]) + "_" + size, encodeMs, pixels, encoded.size());
+		}
+
+		// Single pixel access through get() and set(), the way the renderer used to draw
+		TGAImage target(resolution.width, resolution.height, TGAImage::RGB);
+		double getMs = measureBestMilliseconds(runs, [&]() {
+			unsigned int sum = 0;
+			for (int y = 0; y < resolution.height; y++) {
+				for (int x = 0; x < resolution.width; x++) {
+					sum += image.get(x, y).val;
+				}
+			}
+			benchmarkSink += (float)sum;
+		});
+		double setMs = measureBestMilliseconds(runs, [&]() {
+			TGAColor color(200, 100, 50, 255);
+			for (int y = 0; y < resolution.height; y++) {
+				for (int x = 0; x < resolution.width; x++) {
+					target.set(x, y, color);
+				}
+			}
+		});
+		report.add("tga", "get_" + size, getMs, pixels);
+		report.add("tga", "set_" + size, setMs, pixels);
+	}
+	std::remove(legacyFile);
+	std::remove(currentFile);
+	return passed;
+}
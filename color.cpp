@@ -0,0 +1,17 @@
+#include <cmath>
+#include "color.h"
+
+PackedColor::PackedColor(const TGAColor &color) : val(color.val) {
+	if (color.bytespp == TGAImage::GRAYSCALE) {
+		r = g = b;
+	}
+	if (color.bytespp != TGAImage::RGBA) {
+		a = 255;
+	}
+}
+
+GammaLut::GammaLut(float gamma) {
+	for (int i = 0; i < 256; i++) {
+		table[i] = (unsigned char)(255.f * std::pow(i / 255.f, 1.f / gamma) + .5f);
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef __COLOR_H__
+#define __COLOR_H__
+
+#include <cstdint>
+#include "geometry.h"
+#include "tgaimage.h"
+
+// The color the renderer works with: 4 bytes in the TGAColor layout (b, g, r, a) and nothing else,
+// TGAColor carries its bytespp around which doubles its size. TGAColor only shows up where
+// images are read or written, the constructor and toTGAColor() are that boundary
+struct PackedColor {
+	union {
+		struct {
+			unsigned char b, g, r, a;
+		};
+		unsigned char raw[4];
+		uint32_t val;
+	};
+
+	PackedColor() : val(0) {
+	}
+
+	PackedColor(unsigned char R, unsigned char G, unsigned char B, unsigned char A) : b(B), g(G), r(R), a(A) {
+	}
+
+	explicit PackedColor(uint32_t v) : val(v) {
+	}
+
+	// Grayscale pixels are spread to the three channels, pixels without alpha get an opaque one
+	explicit PackedColor(const TGAColor &color);
+
+	TGAColor toTGAColor() const {
+		return TGAColor((int)val, TGAImage::RGBA);
+	}
+
+	bool operator ==(const PackedColor &c) const {
+		return val == c.val;
+	}
+};
+
+// Lookup table applying out = 255 * (in / 255)^(1 / gamma) to the color channels, gamma has to be greater than 0
+class GammaLut {
+private:
+	unsigned char table[256];
+public:
+	GammaLut(float gamma);
+	unsigned char operator[](int value) const { return table[value]; }
+	PackedColor apply(PackedColor color) const {
+		color.r = table[color.r];
+		color.g = table[color.g];
+		color.b = table[color.b];
+		return color;
+	}
+};
+
+// Multiplies the color channels of count colors by their intensity in place, like TGAColor::operator*
+// the result is truncated but it also saturates to 0..255. Alpha is kept as it is.
+// With a gamma table the modulated color is looked up through it afterwards
+inline void modulateColors(PackedColor *colors, const float *intensities, int count, const GammaLut *gamma = NULL) {
+	int i = 0;
+#if defined(GEOMETRY_USE_SSE2)
+	// 4 pixels per iteration, each one widened to 4 float lanes (b, g, r, a)
+	const __m128 colorLanes = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	const __m128 alphaOne = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(colors + i));
+		__m128 intensity = _mm_loadu_ps(intensities + i);
+		__m128i low = _mm_unpacklo_epi8(pixels, zero);
+		__m128i high = _mm_unpackhi_epi8(pixels, zero);
+		__m128 scale0 = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(intensity, intensity, _MM_SHUFFLE(0, 0, 0, 0)), colorLanes), alphaOne);
+		__m128 scale1 = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(intensity, intensity, _MM_SHUFFLE(1, 1, 1, 1)), colorLanes), alphaOne);
+		__m128 scale2 = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(intensity, intensity, _MM_SHUFFLE(2, 2, 2, 2)), colorLanes), alphaOne);
+		__m128 scale3 = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(intensity, intensity, _MM_SHUFFLE(3, 3, 3, 3)), colorLanes), alphaOne);
+		__m128i c0 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale0));
+		__m128i c1 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale1));
+		__m128i c2 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale2));
+		__m128i c3 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale3));
+		// the two packs saturate to 0..255 on the way back down to bytes
+		_mm_storeu_si128((__m128i*)(colors + i), _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3)));
+	}
+#endif
+	for (; i < count; i++) {
+		for (int channel = 0; channel < 3; channel++) {
+			float value = colors[i].raw[channel] * intensities[i];
+			colors[i].raw[channel] = value <= 0.f ? 0 : (value >= 255.f ? 255 : (unsigned char)value);
+		}
+	}
+	if (gamma != NULL) {
+		for (i = 0; i < count; i++) {
+			colors[i] = gamma->apply(colors[i]);
+		}
+	}
+}
+
+#endif //__COLOR_H__
@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <cstring>
+#include "framebuffer.h"
+
+Framebuffer::Framebuffer(int width, int height) : width(width), height(height) {
+	pitch = (width + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+	// One extra row worth of alignment so the first pixel can be moved to a 64 byte boundary
+	storage.resize((size_t)pitch * height + ROW_ALIGNMENT);
+	uintptr_t address = (uintptr_t)storage.data();
+	uintptr_t aligned = (address + ROW_ALIGNMENT * sizeof(PackedColor) - 1) & ~(uintptr_t)(ROW_ALIGNMENT * sizeof(PackedColor) - 1);
+	pixels = storage.data() + (aligned - address) / sizeof(PackedColor);
+}
+
+void Framebuffer::clear(PackedColor color) {
+	for (int y = 0; y < height; y++) {
+		PackedColor *row = getRow(y);
+		std::fill(row, row + width, color);
+	}
+}
+
+void Framebuffer::writeToImage(TGAImage &image) const {
+	assert(image.get_width() == width && image.get_height() == height);
+	int bytespp = image.get_bytespp();
+	unsigned char *out = image.buffer();
+	for (int y = 0; y < height; y++) {
+		const PackedColor *row = getRow(y);
+		unsigned char *outRow = out + (size_t)y * width * bytespp;
+		if (bytespp == TGAImage::RGBA) {
+			// same byte order as TGA, the row goes out as it is
+			memcpy(outRow, row, width * sizeof(PackedColor));
+			continue;
+		}
+		for (int x = 0; x < width; x++) {
+			memcpy(outRow + x * bytespp, &row[x], bytespp);
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef __FRAMEBUFFER_H__
+#define __FRAMEBUFFER_H__
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "tgaimage.h"
+#include "color.h"
+
+// Color target of the rasterizer: PackedColor pixels with every row
+// starting on a 64 byte boundary. Unlike TGAImage::set nothing here checks its arguments in release
+// builds, callers clip first and then write whole rows or spans through plain pointers.
+// The asserts keep the bounds checking in debug builds
+class Framebuffer {
+private:
+	std::vector<PackedColor> storage;
+	PackedColor *pixels;
+	int width;
+	int height;
+	int pitch;
+
+	Framebuffer(const Framebuffer&);
+	Framebuffer& operator=(const Framebuffer&);
+public:
+	// Rows are padded to a multiple of this many pixels (64 bytes)
+	static const int ROW_ALIGNMENT = 16;
+
+	Framebuffer(int width, int height);
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	// Distance in pixels between the start of two consecutive rows
+	int getPitch() const { return pitch; }
+	bool contains(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+	PackedColor* getRow(int y) {
+		assert(y >= 0 && y < height);
+		return pixels + y * pitch;
+	}
+	const PackedColor* getRow(int y) const {
+		assert(y >= 0 && y < height);
+		return pixels + y * pitch;
+	}
+	// count pixels starting at (x, y), all of them on the same row
+	PackedColor* getSpan(int x, int y, int count) {
+		assert(x >= 0 && count >= 0 && x + count <= width);
+		return getRow(y) + x;
+	}
+	void set(int x, int y, PackedColor color) {
+		*getSpan(x, y, 1) = color;
+	}
+	void clear(PackedColor color);
+	// The only way out of the framebuffer, image must have the same size
+	void writeToImage(TGAImage &image) const;
+};
+
+#endif //__FRAMEBUFFER_H__
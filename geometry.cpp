@@ -115,4 +115,137 @@ Matrix Matrix::vectorToMatrix(Vec3f v) {
 
 Vec3f Matrix::matrixToVector(Matrix m) {
     return Vec3f(m[0][0]/m[3][0], m[1][0]/m[3][0], m[2][0]/m[3][0]);
-}
\ No newline at end of file
+}
+
+Mat4f::Mat4f() {
+    for (int i=0; i<4; i++)
+        for (int j=0; j<4; j++)
+            m[i][j] = 0.f;
+}
+
+Mat4f Mat4f::identity() {
+    Mat4f E;
+    for (int i=0; i<4; i++)
+        E.m[i][i] = 1.f;
+    return E;
+}
+
+Mat4f Mat4f::operator*(const Mat4f& a) const {
+    // Row i of the result is the sum of a's rows weighted by row i of this matrix,
+    // rows are contiguous so no transposition is needed. The accumulation order is
+    // the same as Matrix::operator* so both give the exact same floats
+    Mat4f result;
+#if defined(GEOMETRY_USE_AVX)
+    __m256 b0 = _mm256_broadcast_ps((const __m128*)a.m[0]);
+    __m256 b1 = _mm256_broadcast_ps((const __m128*)a.m[1]);
+    __m256 b2 = _mm256_broadcast_ps((const __m128*)a.m[2]);
+    __m256 b3 = _mm256_broadcast_ps((const __m128*)a.m[3]);
+    for (int i=0; i<4; i+=2) {
+        // two rows per iteration, row i in the low lane and row i+1 in the high lane
+        __m256 r = _mm256_mul_ps(_mm256_insertf128_ps(_mm256_set1_ps(m[i][0]), _mm_set1_ps(m[i+1][0]), 1), b0);
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_insertf128_ps(_mm256_set1_ps(m[i][1]), _mm_set1_ps(m[i+1][1]), 1), b1));
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_insertf128_ps(_mm256_set1_ps(m[i][2]), _mm_set1_ps(m[i+1][2]), 1), b2));
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_insertf128_ps(_mm256_set1_ps(m[i][3]), _mm_set1_ps(m[i+1][3]), 1), b3));
+        _mm256_store_ps(result.m[i], r);
+    }
+#elif defined(GEOMETRY_USE_SSE)
+    __m128 b0 = _mm_load_ps(a.m[0]);
+    __m128 b1 = _mm_load_ps(a.m[1]);
+    __m128 b2 = _mm_load_ps(a.m[2]);
+    __m128 b3 = _mm_load_ps(a.m[3]);
+    for (int i=0; i<4; i++) {
+        __m128 r = _mm_mul_ps(_mm_set1_ps(m[i][0]), b0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m[i][1]), b1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m[i][2]), b2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m[i][3]), b3));
+        _mm_store_ps(result.m[i], r);
+    }
+#else
+    for (int i=0; i<4; i++) {
+        for (int j=0; j<4; j++) {
+            result.m[i][j] = 0.f;
+            for (int k=0; k<4; k++) {
+                result.m[i][j] += m[i][k]*a.m[k][j];
+            }
+        }
+    }
+#endif
+    return result;
+}
+
+Vec4f Mat4f::operator*(const Vec4f& v) const {
+    Vec4f result;
+#if defined(GEOMETRY_USE_SSE)
+    // M*v is a weighted sum of the columns, transpose once to have them in registers
+    __m128 c0 = _mm_load_ps(m[0]);
+    __m128 c1 = _mm_load_ps(m[1]);
+    __m128 c2 = _mm_load_ps(m[2]);
+    __m128 c3 = _mm_load_ps(m[3]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    __m128 r = _mm_mul_ps(c0, _mm_set1_ps(v.x));
+    r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(v.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(v.z)));
+    r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(v.w)));
+    _mm_store_ps(result.raw, r);
+#else
+    for (int i=0; i<4; i++) {
+        result.raw[i] = m[i][0]*v.x + m[i][1]*v.y + m[i][2]*v.z + m[i][3]*v.w;
+    }
+#endif
+    return result;
+}
+
+Vec3f Mat4f::transformPoint(const Vec3f& v) const {
+    Vec3f result;
+    transformBatch(&v, &result, 1);
+    return result;
+}
+
+void Mat4f::transformBatch(const Vec3f* in, Vec3f* out, int count, Vec4f* homogeneous) const {
+#if defined(GEOMETRY_USE_SSE)
+    __m128 c0 = _mm_load_ps(m[0]);
+    __m128 c1 = _mm_load_ps(m[1]);
+    __m128 c2 = _mm_load_ps(m[2]);
+    __m128 c3 = _mm_load_ps(m[3]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    alignas(16) float projected[4];
+    for (int i=0; i<count; i++) {
+        // w is always 1 for a point, so the last column is just added
+        __m128 r = _mm_mul_ps(c0, _mm_set1_ps(in[i].x));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(in[i].y)));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(in[i].z)));
+        r = _mm_add_ps(r, c3);
+        if (homogeneous != NULL) {
+            _mm_storeu_ps(homogeneous[i].raw, r);
+        }
+        r = _mm_div_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)));
+        _mm_store_ps(projected, r);
+        out[i] = Vec3f(projected[0], projected[1], projected[2]);
+    }
+#else
+    for (int i=0; i<count; i++) {
+        Vec4f r = (*this) * Vec4f(in[i].x, in[i].y, in[i].z, 1.f);
+        if (homogeneous != NULL) {
+            homogeneous[i] = r;
+        }
+        out[i] = Vec3f(r.x/r.w, r.y/r.w, r.z/r.w);
+    }
+#endif
+}
+
+Matrix Mat4f::toMatrix() const {
+    Matrix result(4, 4);
+    for (int i=0; i<4; i++)
+        for (int j=0; j<4; j++)
+            result[i][j] = m[i][j];
+    return result;
+}
+
+Mat4f Mat4f::fromMatrix(Matrix& a) {
+    assert(a.getTotalRows()==4 && a.getTotalColumns()==4);
+    Mat4f result;
+    for (int i=0; i<4; i++)
+        for (int j=0; j<4; j++)
+            result.m[i][j] = a[i][j];
+    return result;
+}
@@ -2,8 +2,25 @@
 #define __GEOMETRY_H__
 
 #include <cmath>
+#include <cstddef>
+#include <ostream>
 #include <vector>
 
+// SSE is baseline on every x64 target (and on x86 when /arch:SSE or higher is set),
+// the scalar paths below are only kept for other architectures
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GEOMETRY_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GEOMETRY_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define GEOMETRY_USE_AVX 1
+#include <immintrin.h>
+#endif
+
 
 template <class t> struct Vec2 {
 	union {
@@ -45,7 +62,7 @@ template <class t> struct Vec3 {
 typedef Vec3<float> Vec3f;
 typedef Vec3<int>   Vec3i;
 
-template <class t> struct Vec4 {
+template <class t> struct alignas(16) Vec4 {
 	union {
 		struct {t x, y, z, w;};
 		t raw[4];
@@ -94,4 +111,25 @@ public:
 	friend std::ostream& operator<<(std::ostream& s, Matrix& m);
 };
 
+// Fixed size 4x4 matrix for the vertex path, lives on the stack and is 16-byte aligned
+// so every row can be loaded straight into an SSE register.
+// Matrix is still around for the generic cases (inverse, transpose, non 4x4 sizes)
+struct alignas(16) Mat4f {
+	float m[4][4];
+
+	Mat4f();
+	static Mat4f identity();
+	float*       operator[](const int i)       { return m[i]; }
+	const float* operator[](const int i) const { return m[i]; }
+	Mat4f operator*(const Mat4f& a) const;
+	Vec4f operator*(const Vec4f& v) const;
+	// Embeds v as (x, y, z, 1), transforms it and projects it back to 3D dividing by w
+	Vec3f transformPoint(const Vec3f& v) const;
+	// Same as transformPoint for a whole array, the matrix columns are only loaded once.
+	// When homogeneous is given the positions before the division by w are stored there too, for clipping
+	void transformBatch(const Vec3f* in, Vec3f* out, int count, Vec4f* homogeneous=NULL) const;
+	Matrix toMatrix() const;
+	static Mat4f fromMatrix(Matrix& a);
+};
+
 #endif //__GEOMETRY_H__
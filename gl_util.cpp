@@ -1,4 +1,6 @@
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include "gl_util.h"
@@ -9,16 +11,13 @@ const TGAColor Util::COLOR_RED                 = TGAColor(255, 0,   0,   255);
 const TGAColor Util::COLOR_GREEN               = TGAColor(0, 255,   0,   255);
 const TGAColor Util::COLOR_BLUE                = TGAColor(0, 0,   255,   255);
 const TGAColor Util::COLOR_PURPLE              = TGAColor(255, 0,   255,   255);
-const TGAColor Util::COLOR_BACKGROUND_GRADIENT = TGAColor(-1, 0,   0,   255);
-const TGAColor Util::COLOR_RANDOM              = TGAColor(-2, 0,   0,   255);
-const TGAColor Util::COLOR_TEXTURE             = TGAColor(-3, 0,   0,   255);
 
-Matrix Util::createViewportMatrix(int x, int y, int w, int h, int d) {
+Mat4f Util::createViewportMatrix(int x, int y, int w, int h, int d) {
     // | w/2  0    0    x+w/2  |
     // | 0    h/2  0    y+h/2  |
     // | 0    0    d/2  d/2    |
     // | 0    0    0    1      |
-    Matrix m = Matrix::identity(4);
+    Mat4f m = Mat4f::identity();
     m[0][3] = x + w/2.;
     m[1][3] = y + h/2.;
     m[2][3] = d/2.;
@@ -30,7 +29,7 @@ Matrix Util::createViewportMatrix(int x, int y, int w, int h, int d) {
 }
 
 
-Matrix Util::getViewport(int width, int height, int depth) {
+Mat4f Util::getViewport(int width, int height, int depth) {
     // With this matrix instead of scaling "by hand" the 3D vector to the screen's resolution
     // we use the matrix to do the same calculation, scale by half the screen
     // then move it to the center of the resulting 2D plane
@@ -39,12 +38,12 @@ Matrix Util::getViewport(int width, int height, int depth) {
     float w = width * 3/4;
     float h = height * 3/4;
     float d = depth;
-    Matrix viewport = createViewportMatrix(x, y, w, h, d);
+    Mat4f viewport = createViewportMatrix(x, y, w, h, d);
 
     return viewport;
 }
 
-Matrix Util::getProjection(Vec3f& camera) {
+Mat4f Util::getProjection(Vec3f& camera) {
     // Then the 4D projection matrix just makes sure that when we go back to 3D
     // the viewport/camera matrix will have the vector's Z axis scale back and forth
     // as we please
@@ -52,17 +51,17 @@ Matrix Util::getProjection(Vec3f& camera) {
     // | 0  1    0    0 |
     // | 0  0    1    0 |
     // | 0  0  -1./c  1 |
-    Matrix projection = Matrix::identity(4);
+    Mat4f projection = Mat4f::identity();
     projection[3][2] = -1.f/camera.z;
     return projection;
 }
 
-Matrix Util::generateModelView(Vec3f& eye, Vec3f& center, Vec3f& up) {
+Mat4f Util::generateModelView(Vec3f& eye, Vec3f& center, Vec3f& up) {
     Vec3f z = (eye - center).normalize();
     Vec3f x = (up ^ z).normalize();
     Vec3f y = (z ^ x).normalize();
-    Matrix Minv = Matrix::identity(4);
-    Matrix Tr   = Matrix::identity(4);
+    Mat4f Minv = Mat4f::identity();
+    Mat4f Tr   = Mat4f::identity();
     for (int i=0; i < 3; i++) {
         Minv[0][i] = x[i];
         Minv[1][i] = y[i];
@@ -99,13 +98,23 @@ void Util::rasterize2dDepthBuffer(Vec2i p0, Vec2i p1, TGAImage &image, TGAColor
     }
 }
 
-char* Util::convertWStringToCharPtr(_In_ std::wstring input)
+char* Util::convertWStringToCharPtr(std::wstring input)
 {
     size_t outputSize = input.length() + 1; // +1 for null terminator
     char * outputString = new char[outputSize];
     size_t charsConverted = 0;
     const wchar_t * inputW = input.c_str();
+#ifdef _WIN32
     wcstombs_s(&charsConverted, outputString, outputSize, inputW, input.length());
+#else
+    charsConverted = wcstombs(outputString, inputW, outputSize);
+    if (charsConverted == (size_t)-1) {
+        // a character with no multibyte form in the current locale
+        charsConverted = 0;
+    }
+    // not terminated by wcstombs when the output fills the buffer
+    outputString[std::min(charsConverted, outputSize - 1)] = '\0';
+#endif
     return outputString;
 }
 
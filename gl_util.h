@@ -12,18 +12,15 @@ public:
 	static const TGAColor COLOR_GREEN;
 	static const TGAColor COLOR_BLUE;
 	static const TGAColor COLOR_PURPLE;
-	static const TGAColor COLOR_BACKGROUND_GRADIENT;
-	static const TGAColor COLOR_RANDOM;
-	static const TGAColor COLOR_TEXTURE;
 
-	static Matrix createViewportMatrix(int x, int y, int w, int h, int d);
-	static Matrix getViewport(int width, int height, int depth);
-	static Matrix getProjection(Vec3f& camera);
-	static Matrix generateModelView(Vec3f& eye, Vec3f& center, Vec3f& up);
+	static Mat4f createViewportMatrix(int x, int y, int w, int h, int d);
+	static Mat4f getViewport(int width, int height, int depth);
+	static Mat4f getProjection(Vec3f& camera);
+	static Mat4f generateModelView(Vec3f& eye, Vec3f& center, Vec3f& up);
 	static Vec2f calculateTriangleCentroid(Vec2i t0, Vec2i t1, Vec2i t2);
 	static void drawVectorToPoint(std::vector<Vec2f> linePoints, Vec2f point, TGAImage &image, TGAColor color);
 	static void rasterize2dDepthBuffer(Vec2i p0, Vec2i p1, TGAImage &image, TGAColor color, int yBuffer[]);
-	static char* convertWStringToCharPtr(_In_ std::wstring input);
+	static char* convertWStringToCharPtr(std::wstring input);
 	static Vec2f linearInterpolate(Vec2f v0, Vec2f v1, float t);
 	static Vec3f lerp(const Vec3f& start, const Vec3f& end, float t);
 	static Vec3f interpolateVectors(const Vec3f& a, const Vec3f& b, const Vec3f& c, float t);
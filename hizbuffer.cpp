@@ -0,0 +1,70 @@
+#include <algorithm>
+#include "geometry.h"
+#include "hizbuffer.h"
+
+HiZBuffer::HiZBuffer(int width, int height) : tilesX((width + TILE_SIZE - 1) / TILE_SIZE), tilesY((height + TILE_SIZE - 1) / TILE_SIZE), culledTriangles(0), culledTiles(0), culledPixels(0) {
+	farthest.resize(tilesX * tilesY);
+}
+
+void HiZBuffer::clear(float depth) {
+	std::fill(farthest.begin(), farthest.end(), depth);
+}
+
+void HiZBuffer::update(const float *zbuffer, int width, int height, int tileX, int tileY) {
+	int x0 = tileX * TILE_SIZE;
+	int y0 = tileY * TILE_SIZE;
+	int x1 = std::min(x0 + TILE_SIZE, width);
+	int y1 = std::min(y0 + TILE_SIZE, height);
+	float tileFarthest;
+#if defined(GEOMETRY_USE_SSE)
+	if (x1 - x0 == TILE_SIZE) {
+		__m128 farthest4 = _mm_loadu_ps(zbuffer + x0 + y0 * width);
+		for (int y = y0; y < y1; y++) {
+			const float *row = zbuffer + x0 + y * width;
+			farthest4 = _mm_min_ps(farthest4, _mm_min_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+		}
+		farthest4 = _mm_min_ps(farthest4, _mm_shuffle_ps(farthest4, farthest4, _MM_SHUFFLE(1, 0, 3, 2)));
+		farthest4 = _mm_min_ps(farthest4, _mm_shuffle_ps(farthest4, farthest4, _MM_SHUFFLE(2, 3, 0, 1)));
+		tileFarthest = _mm_cvtss_f32(farthest4);
+		farthest[tileX + tileY * tilesX] = tileFarthest;
+		return;
+	}
+#endif
+	tileFarthest = zbuffer[x0 + y0 * width];
+	for (int y = y0; y < y1; y++) {
+		for (int x = x0; x < x1; x++) {
+			tileFarthest = std::min(tileFarthest, zbuffer[x + y * width]);
+		}
+	}
+	farthest[tileX + tileY * tilesX] = tileFarthest;
+}
+
+bool HiZBuffer::isOccluded(int xMin, int yMin, int xMax, int yMax, float nearestDepth) const {
+	for (int tileY = yMin / TILE_SIZE; tileY <= yMax / TILE_SIZE; tileY++) {
+		for (int tileX = xMin / TILE_SIZE; tileX <= xMax / TILE_SIZE; tileX++) {
+			if (nearestDepth > getFarthest(tileX, tileY)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void HiZBuffer::addCulledTriangles(long long triangles) {
+	culledTriangles += triangles;
+}
+
+void HiZBuffer::addCulledRectangle(long long pixels) {
+	culledPixels += pixels;
+}
+
+void HiZBuffer::addCulledTile(long long pixels) {
+	culledTiles++;
+	culledPixels += pixels;
+}
+
+void HiZBuffer::resetCounters() {
+	culledTriangles = 0;
+	culledTiles = 0;
+	culledPixels = 0;
+}
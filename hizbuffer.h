@@ -0,0 +1,40 @@
+#ifndef __HIZBUFFER_H__
+#define __HIZBUFFER_H__
+
+#include <atomic>
+#include <vector>
+
+// Coarse level on top of the z buffer holding the farthest depth of every 8x8 tile.
+// Anything whose nearest depth is not in front of that value is hidden by what was already drawn,
+// so it can be dropped before any per pixel work. The stored values are allowed to be farther
+// than the real ones (they are only refreshed after a tile is written) which keeps it conservative
+class HiZBuffer {
+private:
+	std::vector<float> farthest;
+	int tilesX;
+	int tilesY;
+	std::atomic<long long> culledTriangles;
+	std::atomic<long long> culledTiles;
+	std::atomic<long long> culledPixels;
+public:
+	static const int TILE_SIZE = 8;
+
+	HiZBuffer(int width, int height);
+	void clear(float depth);
+	float getFarthest(int tileX, int tileY) const { return farthest[tileX + tileY * tilesX]; }
+	// Recomputes the farthest depth of a tile from the full resolution z buffer
+	void update(const float *zbuffer, int width, int height, int tileX, int tileY);
+	// True if nearestDepth is behind or at the farthest depth of every tile touching the rectangle
+	bool isOccluded(int xMin, int yMin, int xMax, int yMax, float nearestDepth) const;
+
+	// A triangle is counted once its whole bounding box was culled, the pixels of each rectangle as it is dropped
+	void addCulledTriangles(long long triangles);
+	void addCulledRectangle(long long pixels);
+	void addCulledTile(long long pixels);
+	void resetCounters();
+	long long getCulledTriangles() const { return culledTriangles; }
+	long long getCulledTiles() const { return culledTiles; }
+	long long getCulledPixels() const { return culledPixels; }
+};
+
+#endif //__HIZBUFFER_H__
@@ -1,255 +1,129 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <future>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <fstream>
 #include "tgaimage.h"
 #include "model.h"
 #include "geometry.h"
+#ifdef _WIN32
 #include <shlwapi.h>
+#endif
 #include <vector>
 #include "gl_util.h"
-#include "shaders.h"
+#include "threadpool.h"
+#include "hizbuffer.h"
+#include "texture.h"
+#include "framebuffer.h"
+#include "color.h"
+#include "pipelinestats.h"
+#include "renderer.h"
+#include "renderserver.h"
 
 
 const int WIDTH  = 800;
 const int HEIGHT = 800;
-const int DEPTH = 255;
 
 const std::wstring OUTPUT_TGA_NAME = L"output.tga";
 
-float *zBuffer = new float[WIDTH * HEIGHT];
-Model *model = NULL;
-TGAImage *diffuseTexture =  new TGAImage();
-Vec2i clamp(WIDTH - 1, HEIGHT - 1);
-
-Vec3f eye(1,1, 3);
-Vec3f center(0,0,0);
-Vec3f up(0,1,0);
-Vec3f camera(0,0,1000);
-Vec3f lightDirection(0,0,-1);
-
-Matrix viewport = Util::getViewport(WIDTH, HEIGHT, DEPTH);
-Matrix modelView = Util::generateModelView(eye, center, up);
-Matrix projection = Util::getProjection(camera);
-
-
-std::vector<Vec2f> drawLine(int x0, int y0, int x1, int y1, TGAImage &image, TGAColor color) {
-	std::vector<Vec2f> linePoints;
-	
-	bool steep = false; 
-	if (std::abs(x0-x1) < std::abs(y0-y1)) {  // if the line is steep, we transpose the image 
-		std::swap(x0, y0); 
-		std::swap(x1, y1); 
-		steep = true; 
-	} 
-	if (x0 > x1) { // make it left−to−right 
-		std::swap(x0, x1); 
-		std::swap(y0, y1); 
-	} 
-	int dx = x1-x0; 
-	int dy = y1-y0; 
-	int derror2 = std::abs(dy)*2; 
-	int error2 = 0; 
-	int y = y0; 
-	for (int x=x0; x <= x1; x++) { 
-		if (steep) {
-			linePoints.push_back(Vec2f(y, x));
-			image.set(y, x, color); // if transposed, de−transpose 
-		} else {
-			linePoints.push_back(Vec2f(x, y));
-			image.set(x, y, color); 
-		} 
-		error2 += derror2; 
-		if (error2 > dx) { 
-			y += (y1 > y0 ? 1 : -1); 
-			error2 -= dx*2; 
-		} 
-	}
-
-	return linePoints;
-} 
-
-Vec3f getBarycentricVector(Vec3f *triangleVertex, Vec3f P) {
-	// This calculation comes from a linear system of equations when considering u + v + w = 1 in barycentric coordinate theory
-	// The result is a vector [u, v, 1] that is perpendicular to (ACx, ABx, PAx) and (ACy, ABy, PAy)
-	// (ACx, ABx, PAx) cross product (ACy, ABy, PAy) should give us the normal vector, with a z value that must be 1
-	// if not, P doesn't belong in this triangle 
-	Vec3f barycentricWeight = Vec3f(triangleVertex[2].x-triangleVertex[0].x, triangleVertex[1].x-triangleVertex[0].x, triangleVertex[0].x-P.x)^Vec3f(triangleVertex[2].y-triangleVertex[0].y, triangleVertex[1].y-triangleVertex[0].y, triangleVertex[0].y-P.y);
+// Format of the output images when their name does not tell it, set with --format
+TGAImage::FileFormat outputFormat = TGAImage::TGA_FILE;
+// With --stats every frame is a JSON line of statsFile
+std::ofstream statsFile;
+// Runs the TGA encoder. In orbit mode it encodes while renderWorkers draws the next frame, so it can't be that pool
+ThreadPool *encodeWorkers = NULL;
+
+// The image is only filled once the frame is done. In orbit mode this runs on its own thread
+// while the next frame is being drawn, so it must not touch anything but its framebuffer and stats.
+// The encoder is picked from the extension of fileName (tga, qoi, ppm or pam).
+// With stats the encoding is added to them and the frame goes out as a line of statsFile
+void writeFrame(const Framebuffer *framebuffer, std::string fileName, FrameStats *stats) {
+	TGAImage image(framebuffer->getWidth(), framebuffer->getHeight(), TGAImage::RGB);
+	framebuffer->writeToImage(image);
+	image.flip_vertically(); // Origin is at the left bottom corner of the image
 
-	// triangleVertex and P has integer value as coordinates
-	// so abs(barycentricWeight[2]) < 1 means barycentricWeight[2] is 0, that means
-	// triangle is degenerate, in this case return something with negative coordinates
-	if (std::abs(barycentricWeight.z)<1) {
-		return Vec3f(-1,1,1);
+	TGAImage::FileFormat format = TGAImage::format_from_filename(fileName.c_str(), outputFormat);
+	std::vector<unsigned char> file;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	image.encode(format, file, encodeWorkers);
+	std::chrono::duration<double, std::milli> encodeTime = std::chrono::steady_clock::now() - start;
+	TGAImage::write_buffer(fileName.c_str(), file);
+
+	// a single write so the lines of frames encoded at the same time don't get mixed
+	std::ostringstream report;
+	report << "# encoded " << fileName << " " << TGAImage::format_extension(format) << " " << file.size() << " bytes in " << encodeTime.count() << " ms\n";
+	std::cerr << report.str();
+
+	if (stats != NULL) {
+		stats->milliseconds[FrameStats::STAGE_ENCODE] = encodeTime.count();
+		stats->counters[FrameStats::BYTES_ENCODED] = (long long)file.size();
+		statsFile << stats->toJson() << std::endl;
 	}
-	return Vec3f(1.f-(barycentricWeight.x+barycentricWeight.y)/barycentricWeight.z, barycentricWeight.y/barycentricWeight.z, barycentricWeight.x/barycentricWeight.z); 
 }
 
-void setScreenBoundaries(Vec3f *triangleVertex, Vec2i* bboxMin, Vec2i* bboxMax, TGAImage &image) {
-	bboxMin->u = image.get_width()-1;
-	bboxMin->v =  image.get_height()-1; 
-	bboxMax->u = 0;
-	bboxMax->v = 0;
-	for (int i=0; i<3; i++) {  
-		bboxMin->x = std::max<int>(0, std::min<int>(bboxMin->x, triangleVertex[i].x));
-		bboxMin->y = std::max<int>(0, std::min<int>(bboxMin->y, triangleVertex[i].y));
-
-		bboxMax->x = std::min<int>(clamp.x, std::max<int>(bboxMax->x, triangleVertex[i].x));
-		bboxMax->y = std::min<int>(clamp.y, std::max<int>(bboxMax->y, triangleVertex[i].y));
-	} 
+std::string getFrameFileName(int frame) {
+	std::ostringstream fileName;
+	fileName << "output_" << std::setw(4) << std::setfill('0') << frame << "." << TGAImage::format_extension(outputFormat);
+	return fileName.str();
 }
 
-Vec3f calculateCameraVertex(Vec3f& vector) {
-	// Let's transform the original 3D vector into 4D for homogeneous coordinates
-	// projected, scaled, and turn back to 3D
-	Matrix vector4D = Matrix::vectorToMatrix(vector);
- 
-	GouraudShader shader(viewport, projection, modelView);
-	
-	Vec3f result = Matrix::matrixToVector( viewport * projection * modelView * vector4D );
-
-	return result;
-	
-	// This is the "flat" calculation method for the 3D vectors on a 2D plane without camera projection
-	// scaled to the resolution of the screen or image
-	// Since there is no transformation or rotation of any kind, the camera would be fixed on (0, 0, z)
-	// float x0 = (vector.x + 1.) * (float)WIDTH / 2.;
-	// float y0 = (vector.y + 1.) * (float)HEIGHT / 2.;
-	// float z0 = vector.z * (float)DEPTH;
-	
-	// return Vec3f(x0, y0, z0);
-}
-
-void drawTriangleWithZBuffer(Vec3f *triangleVertex, TGAImage* diffuseTexture, Vec3f *uvTextureVertex, float *zbuffer, TGAImage &image, const float intensity, TGAColor color) { 	
-	Vec3f triangleVertexProjected[3];
-	
-	for (int i = 0; i < 3; i++) {
-		triangleVertexProjected[i] = calculateCameraVertex(triangleVertex[i]);
-	}
-
-	Vec2i* bboxMin = new Vec2i();
-	Vec2i* bboxMax = new Vec2i();
-	setScreenBoundaries(triangleVertexProjected, bboxMin, bboxMax, image );
-	
-	Vec3f P;
-	
-	TGAColor randomColor(rand() % 255, rand() % 255, rand() % 255, 255);
-
-	for (P.x = bboxMin->x; P.x <= bboxMax->x; P.x++) { 
-		for (P.y = bboxMin->y; P.y <= bboxMax->y; P.y++) {
-			Vec3f barycentricWeights  = getBarycentricVector(triangleVertexProjected, P); 
-			if (barycentricWeights.x < 0 || barycentricWeights.y < 0 || barycentricWeights.z < 0) {
-				// Barycentric point is out of the triangle's area, so not a valid coordinate
-				continue;
-			}
-			
-			P.z = 0;
-			P.z += triangleVertexProjected[0].z * barycentricWeights.x;
-			P.z += triangleVertexProjected[1].z * barycentricWeights.y;
-			P.z += triangleVertexProjected[2].z * barycentricWeights.z;
-			if (zbuffer[int(P.x + P.y * WIDTH)] >= P.z) {
-				continue;
-			}
-
-			// This is a visible point, update the Z Buffer
-			zbuffer[int(P.x + P.y * WIDTH)] = P.z;
-			
-			if (color == Util::COLOR_BACKGROUND_GRADIENT) {
-				Vec3f normalizedPixel = Util::normalizeVector(&P, WIDTH, HEIGHT, WIDTH + HEIGHT, 1);
-				image.set(P.x, P.y, TGAColor(255 * normalizedPixel.x, 255 * normalizedPixel.y,   0,   255));
-			} else if (color == Util::COLOR_RANDOM) {
-				image.set(P.x, P.y, randomColor);
-			} else if (color == Util::COLOR_TEXTURE) {
-				if (diffuseTexture == nullptr) {
-					image.set(P.x, P.y, Util::COLOR_WHITE * intensity);
-					continue;
-				}
-
-				// We use the calculated barycentricWeights from P across the original triangle
-				// And interpolate it through the texture triangle
-				Vec3f interpolatedPoint = uvTextureVertex[0] * barycentricWeights.x + uvTextureVertex[1] * barycentricWeights.y + uvTextureVertex[2] * barycentricWeights.z;
-					
-				TGAColor sectionColor = diffuseTexture->get(
-					(float)diffuseTexture->get_width() * interpolatedPoint.x,
-					(float)diffuseTexture->get_height() * interpolatedPoint.y
-				);
-				
-				image.set(P.x, P.y, sectionColor * intensity);
-			} else {
-				image.set(P.x, P.y, color * intensity);
-			}
-		} 
-	}
-
-	delete bboxMax;
-	delete bboxMin;
+// eye rotated by angle radians around the up axis going through center (Rodrigues' rotation formula)
+Vec3f orbitEye(Vec3f orbitStart, float angle) {
+	Vec3f axis = up;
+	axis.normalize();
+	Vec3f offset = orbitStart - center;
+	Vec3f rotated = offset * std::cos(angle) + (axis ^ offset) * std::sin(angle) + axis * ((axis * offset) * (1.f - std::cos(angle)));
+	return center + rotated;
 }
 
-void drawTriangleSurfaces(TGAImage &image, TGAImage* diffuseTexture, bool enableLight) {
-	for (int i=0; i < model->getTotalFaces(); i++) {
-		std::vector<std::vector<int>> face = model->getFaceByIndex(i);
-		Vec3f triangleVertex[3] = {};
-		Vec3f textureCoords[3];
-		for (int j=0; j < 3; j++) {
-			std::vector<int> faceVertex = face[j];
-
-			Vec3f vertex = model->getVertexByIndex(faceVertex[0]);
-
-			triangleVertex[j] = vertex;
-			
-			textureCoords[j] =  model->getTextureVertexByIndex(faceVertex[1]);
+// A full turn of the camera around the model in totalFrames frames written as output_NNNN.tga (or .qoi, .ppm, .pam).
+// Model, texture and z buffer are shared by all the frames, the color buffers alternate:
+// frame k+1 is drawn into one while frame k is flipped and encoded from the other
+void renderOrbit(int totalFrames, ShadingMode shadingMode) {
+	Framebuffer firstBuffer(WIDTH, HEIGHT);
+	Framebuffer secondBuffer(WIDTH, HEIGHT);
+	Framebuffer *framebuffers[2] = { &firstBuffer, &secondBuffer };
+	// Like the buffers, the stats of a frame stay around until it is written
+	FrameStats frameStats[2];
+	std::future<void> pendingFrame;
+	Vec3f orbitStart = eye;
+	const float fullTurn = 6.28318531f;
+	for (int frame = 0; frame < totalFrames; frame++) {
+		Framebuffer &framebuffer = *framebuffers[frame % 2];
+		eye = orbitEye(orbitStart, fullTurn * frame / totalFrames);
+		modelView = Util::generateModelView(eye, center, up);
+
+		clearFrame(framebuffer);
+		drawObjModel(framebuffer, diffuseTexture, shadingMode, false);
+
+		// The previous frame has to be out before its buffer is drawn into again by the next one
+		if (pendingFrame.valid()) {
+			pendingFrame.get();
 		}
-
-		if (enableLight) {
-			Vec3f normalVector = (triangleVertex[2]-triangleVertex[0])^(triangleVertex[1]-triangleVertex[0]); 
-			normalVector.normalize(); 
-			float intensity = normalVector * lightDirection; 
-			if (intensity > 0) { 
-				drawTriangleWithZBuffer(triangleVertex, diffuseTexture, textureCoords, zBuffer, image, intensity, Util::COLOR_TEXTURE); 
-			} 
-		} else {
-			drawTriangleWithZBuffer(triangleVertex, diffuseTexture, textureCoords, zBuffer, image, 1., Util::COLOR_BACKGROUND_GRADIENT);
-		} 
-	}
-}
-
-void drawWireframeObjModel(TGAImage &image) {
-	float* wireframeZBuffer = new float[model->getTotalFaces() * 3];
-	for (int i=0; i < model->getTotalFaces(); i++) {
-		std::vector<std::vector<int>> face = model->getFaceByIndex(i);
-		for (int j=0; j < face.size(); j++) {
-			std::vector<int> faceVertexOrigin = face[j];
-			Vec3f v0 = model->getVertexByIndex(faceVertexOrigin[0]);
-
-			std::vector<int> faceVertexEnd = face[(j+1)%3];
-			Vec3f v1 = model->getVertexByIndex(faceVertexEnd[0]);
-
-			// TODO try at creating a z buffer for the wireframe, needs refinement
-			// float indexZ = 0.;
-			// indexZ += (v0.z + v1.z) / 2;
-			// if (wireframeZBuffer[int(i + j * 3)] >= indexZ) {
-			// 	continue;
-			// }
-			// wireframeZBuffer[int(i + j * 3)] = indexZ;
-			
-			Vec3f r0 = calculateCameraVertex(v0);
-			Vec3f r1 = calculateCameraVertex(v1);
-			drawLine(r0.x, r0.y, r1.x, r1.y, image, Util::COLOR_WHITE);
+		FrameStats *stats = NULL;
+		if (pipelineStats != NULL) {
+			frameStats[frame % 2] = finishFrameStats(frame);
+			stats = &frameStats[frame % 2];
 		}
+		pendingFrame = std::async(std::launch::async, writeFrame, &framebuffer, getFrameFileName(frame), stats);
 	}
-	delete[] wireframeZBuffer;
-}
-
-void drawObjModel(TGAImage &image, TGAImage* diffuseTexture, bool enableLight, bool enableWireframe) {
-	if (diffuseTexture != nullptr) {
-		drawTriangleSurfaces(image, diffuseTexture, enableLight);
+	if (pendingFrame.valid()) {
+		pendingFrame.get();
 	}
-	
-	if (enableWireframe) {
-		drawWireframeObjModel(image);
-	} 
+	eye = orbitStart;
+	modelView = Util::generateModelView(eye, center, up);
 }
 
+// Only on Windows, elsewhere the image is just left in the working directory
 void openTGAOutput() {
+#ifdef _WIN32
 	SHELLEXECUTEINFOW ShExecInfo = {};
 	ShExecInfo.cbSize = sizeof(SHELLEXECUTEINFOW);
 	ShExecInfo.lpVerb = L"edit";
@@ -262,35 +136,209 @@ void openTGAOutput() {
 	if (!ShellExecuteExW(&ShExecInfo)) {
 		// Error reported in GetLastError()
 	}
+#endif
+}
+
+void printUsage(std::ostream &out) {
+	out << "usage: simplerenderer [options] [model.obj]\n"
+		<< "  --shader=<texture|gouraud|gradient|flat|random>\n"
+		<< "  --output=<file>              its extension (tga, qoi, ppm or pam) picks the format\n"
+		<< "  --format=<tga|qoi|ppm|pam>   format of the outputs whose name doesn't tell it\n"
+		<< "  --orbit=<frames>             renders a turntable of output_NNNN files\n"
+		<< "  --gamma=<value>              greater than 0\n"
+		<< "  --stats=<file>               JSON lines with the load times and every frame's stages and counters\n"
+		<< "  --server                     renders the jobs read from stdin, one per line\n"
+		<< "  --cache-mb=<megabytes>       memory the server keeps loaded models and textures in\n"
+		<< "  --optimize-mesh --no-mesh-cache --no-hiz --no-backface-culling --barycentric\n"
+		<< "  --visibility-buffer --front-to-back --depth-prepass\n";
 }
 
 int main(int argc, char** argv) {
-	if (2 == argc) {
-		model = new Model(argv[1]);
-	} else {
-		model = new Model("obj/head.obj");
+	const char *modelPath = "obj/head.obj";
+	bool enableHiZ = true;
+	bool useMeshCache = true;
+	// Welds and reorders the mesh for the vertex cache at load time, set with --optimize-mesh
+	bool optimizeMesh = false;
+	ShadingMode shadingMode = SHADING_TEXTURE;
+	// Frames of the turntable, 0 renders the single output.tga
+	int orbitFrames = 0;
+	// Set with --output, its extension picks the format
+	std::string outputPath;
+	// JSON lines with the load times and the stages and counters of every frame, set with --stats
+	std::string statsPath;
+	// Render jobs read from stdin instead of the single image, see RenderServer
+	bool serverMode = false;
+	// Memory the server can keep loaded models and textures in, set with --cache-mb
+	size_t assetCacheBudget = (size_t)512 << 20;
+	for (int i = 1; i < argc; i++) {
+		std::string argument(argv[i]);
+		if (argument == "--barycentric") {
+			// the previous per pixel barycentric rasterizer, kept around for comparisons
+			rasterizerMode = RASTERIZER_BARYCENTRIC;
+		} else if (argument == "--no-hiz") {
+			enableHiZ = false;
+		} else if (argument == "--no-backface-culling") {
+			backfaceCulling = false;
+		} else if (argument == "--visibility-buffer") {
+			visibilityBuffer = true;
+		} else if (argument == "--front-to-back") {
+			frontToBack = true;
+		} else if (argument == "--depth-prepass") {
+			depthPrepass = true;
+		} else if (argument == "--no-mesh-cache") {
+			useMeshCache = false;
+		} else if (argument == "--optimize-mesh") {
+			optimizeMesh = true;
+		} else if (argument.compare(0, 8, "--orbit=") == 0) {
+			orbitFrames = std::max(0, std::atoi(argument.c_str() + 8));
+		} else if (argument.compare(0, 8, "--gamma=") == 0) {
+			// the table is built with pow(value, 1/gamma), so anything but a positive number is a mistake
+			const char *value = argument.c_str() + 8;
+			char *end = NULL;
+			float gamma = (float)std::strtod(value, &end);
+			if (end == value || *end != '\0' || !std::isfinite(gamma) || gamma <= 0) {
+				std::cerr << "usage: --gamma=<value>, the value must be a number greater than 0, got \"" << value << "\"\n";
+				return 1;
+			}
+			delete gammaLut;
+			gammaLut = new GammaLut(gamma);
+		} else if (argument == "--format=tga") {
+			outputFormat = TGAImage::TGA_FILE;
+		} else if (argument == "--format=qoi") {
+			outputFormat = TGAImage::QOI_FILE;
+		} else if (argument == "--format=ppm") {
+			outputFormat = TGAImage::PPM_FILE;
+		} else if (argument == "--format=pam") {
+			outputFormat = TGAImage::PAM_FILE;
+		} else if (argument.compare(0, 9, "--output=") == 0) {
+			outputPath = argument.substr(9);
+		} else if (argument.compare(0, 8, "--stats=") == 0) {
+			statsPath = argument.substr(8);
+		} else if (argument.compare(0, 9, "--shader=") == 0) {
+			if (!parseShadingMode(argument.substr(9), shadingMode)) {
+				std::cerr << "unknown shader " << argument.substr(9) << "\n";
+				printUsage(std::cerr);
+				return 1;
+			}
+		} else if (argument == "--server") {
+			serverMode = true;
+		} else if (argument.compare(0, 11, "--cache-mb=") == 0) {
+			assetCacheBudget = (size_t)std::max(0, std::atoi(argument.c_str() + 11)) << 20;
+		} else if (argument == "--help") {
+			printUsage(std::cout);
+			return 0;
+		} else if (argument.compare(0, 2, "--") == 0) {
+			// a misspelled option would otherwise be loaded as the model
+			std::cerr << "unknown option " << argument << "\n";
+			printUsage(std::cerr);
+			return 1;
+		} else {
+			modelPath = argv[i];
+		}
+	}
+	if (serverMode) {
+		renderWorkers = new ThreadPool();
+		if (enableHiZ) {
+			hiZBuffer = new HiZBuffer(WIDTH, HEIGHT);
+		}
+		setResolution(WIDTH, HEIGHT);
+
+		// The command line sets what the jobs don't
+		RenderJob defaults;
+		defaults.modelPath = modelPath;
+		defaults.width = WIDTH;
+		defaults.height = HEIGHT;
+		defaults.shadingMode = shadingMode;
+		defaults.outputPath = outputPath;
+		int failedJobs;
+		{
+			RenderServer server(useMeshCache, assetCacheBudget, optimizeMesh);
+			failedJobs = server.run(std::cin, std::cout, defaults);
+		}
+		delete renderWorkers;
+		delete hiZBuffer;
+		delete gammaLut;
+		return failedJobs > 0 ? 1 : 0;
 	}
-	
-	TGAImage image(WIDTH, HEIGHT, TGAImage::RGB);
 
-	diffuseTexture->read_tga_file("obj/head_diffuse.tga");
-	diffuseTexture->flip_vertically();
+	if (!statsPath.empty()) {
+		statsFile.open(statsPath.c_str());
+		if (statsFile.is_open()) {
+			pipelineStats = new PipelineStats();
+		} else {
+			std::cerr << "can't open the stats file " << statsPath << "\n";
+		}
+	}
 
+	std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+	model = new Model(modelPath, useMeshCache, optimizeMesh);
+	std::chrono::duration<double, std::milli> modelLoadTime = std::chrono::steady_clock::now() - loadStart;
+	if (model->getTotalFaces() == 0) {
+		std::cerr << "can't load the model " << modelPath << "\n";
+		delete model;
+		delete gammaLut;
+		delete pipelineStats;
+		return 1;
+	}
 	
-	// drawTriangleExamples(image);
-	drawObjModel(image, diffuseTexture, true, false);
-	
-	
-	image.flip_vertically(); // Origin is at the left bottom corner of the image
-	char* outputFileName = Util::convertWStringToCharPtr(OUTPUT_TGA_NAME);
-	image.write_tga_file(outputFileName);
-	// modelDiffuseTexture->write_tga_file(outputFileName);
+	renderWorkers = new ThreadPool();
+	encodeWorkers = new ThreadPool();
+	if (enableHiZ) {
+		hiZBuffer = new HiZBuffer(WIDTH, HEIGHT);
+	}
+	setResolution(WIDTH, HEIGHT);
+
+	loadStart = std::chrono::steady_clock::now();
+	TGAImage diffuseImage;
+	if (diffuseImage.read_tga_file("obj/head_diffuse.tga")) {
+		diffuseImage.flip_vertically();
+		diffuseTexture = new Texture(diffuseImage);
+	}
+	std::chrono::duration<double, std::milli> textureLoadTime = std::chrono::steady_clock::now() - loadStart;
+	if (pipelineStats != NULL) {
+		// Loading happens once, it gets its own line ahead of the frames
+		statsFile << "{\"load_ms\": {\"model\": " << modelLoadTime.count() << ", \"texture\": " << textureLoadTime.count()
+			<< "}, \"faces\": " << model->getTotalFaces() << ", \"vertices\": " << model->getTotalVertices();
+		if (model->isOptimized()) {
+			statsFile << ", \"acmr\": {\"before\": " << model->getAcmrBefore() << ", \"after\": " << model->getAcmrAfter() << "}";
+		}
+		statsFile << "}" << std::endl;
+	}
+
+	std::string outputFileName = "output." + std::string(TGAImage::format_extension(outputFormat));
+	if (!outputPath.empty()) {
+		outputFileName = outputPath;
+	}
+	if (orbitFrames > 0) {
+		renderOrbit(orbitFrames, shadingMode);
+	} else {
+		Framebuffer framebuffer(WIDTH, HEIGHT);
+		clearFrame(framebuffer);
+		// drawTriangleExamples(image);
+		drawObjModel(framebuffer, diffuseTexture, shadingMode, false);
+		FrameStats stats;
+		if (pipelineStats != NULL) {
+			stats = finishFrameStats(0);
+		}
+		writeFrame(&framebuffer, outputFileName, pipelineStats != NULL ? &stats : NULL);
+		// modelDiffuseTexture->write_tga_file(outputFileName);
+	}
 	
 	delete model;
-	delete outputFileName;
 	delete diffuseTexture;
+	delete renderWorkers;
+	delete encodeWorkers;
+	delete gammaLut;
+	delete pipelineStats;
+	if (hiZBuffer != NULL) {
+		std::cerr << "# hiz culled triangles# " << hiZBuffer->getCulledTriangles() << " tiles# " << hiZBuffer->getCulledTiles() << " pixels# " << hiZBuffer->getCulledPixels() << std::endl;
+		delete hiZBuffer;
+	}
 
-	openTGAOutput();
+	// Only the default output.tga is opened in the image editor
+	if (orbitFrames == 0 && outputPath.empty() && outputFormat == TGAImage::TGA_FILE) {
+		openTGAOutput();
+	}
 	
 	return 0;
 }
@@ -0,0 +1,105 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : data(NULL), size(0), opened(false), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL) {
+}
+
+bool MappedFile::open(const char *filename) {
+	close();
+	fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize)) {
+		close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	opened = true;
+	if (size == 0) {
+		// an empty file can't be mapped, but it is still a valid file
+		return true;
+	}
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL) {
+		close();
+		return false;
+	}
+	data = (const char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+	data = NULL;
+	size = 0;
+	opened = false;
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile() : data(NULL), size(0), opened(false), fileDescriptor(-1) {
+}
+
+bool MappedFile::open(const char *filename) {
+	close();
+	fileDescriptor = ::open(filename, O_RDONLY);
+	if (fileDescriptor < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(fileDescriptor, &info) != 0) {
+		close();
+		return false;
+	}
+	size = (size_t)info.st_size;
+	opened = true;
+	if (size == 0) {
+		// an empty file can't be mapped, but it is still a valid file
+		return true;
+	}
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return false;
+	}
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	data = (const char *)mapping;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) munmap((void *)data, size);
+	if (fileDescriptor >= 0) ::close(fileDescriptor);
+	data = NULL;
+	size = 0;
+	opened = false;
+	fileDescriptor = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
@@ -0,0 +1,32 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <cstddef>
+
+// Read only memory mapping of a whole file, the contents are paged in by the OS on demand
+// instead of being copied through a stream
+class MappedFile {
+private:
+	const char *data;
+	size_t size;
+	bool opened;
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+	MappedFile(const MappedFile &);
+	MappedFile & operator =(const MappedFile &);
+public:
+	MappedFile();
+	~MappedFile();
+	bool open(const char *filename);
+	void close();
+	bool isOpen() const { return opened; }
+	// NULL for an empty file
+	const char *getData() const { return data; }
+	size_t getSize() const { return size; }
+};
+
+#endif //__MAPPEDFILE_H__
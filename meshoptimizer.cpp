@@ -0,0 +1,217 @@
+#include <cstring>
+#include <unordered_map>
+#include "meshoptimizer.h"
+
+const uint32_t NO_VERTEX = 0xFFFFFFFF;
+
+const uint32_t MISSING_TEXTURE = 1;
+const uint32_t MISSING_NORMAL = 2;
+
+// Position, texture coordinate and normal of a face corner, compared bit for bit.
+// A corner without texture coordinate or normal is kept apart from one that has zeros there
+struct VertexKey {
+	float values[9];
+	uint32_t missing;
+
+	bool operator ==(const VertexKey &other) const {
+		return memcmp(values, other.values, sizeof(values)) == 0 && missing == other.missing;
+	}
+};
+
+struct VertexKeyHash {
+	size_t operator ()(const VertexKey &key) const {
+		uint64_t hash = 0x9E3779B97F4A7C15ull;
+		for (int i = 0; i < 9; i++) {
+			uint32_t bits;
+			memcpy(&bits, &key.values[i], sizeof(bits));
+			hash = (hash ^ bits) * 0xFF51AFD7ED558CCDull;
+			hash ^= hash >> 29;
+		}
+		return (size_t)(hash ^ key.missing);
+	}
+};
+
+float computeAcmr(const std::vector<uint32_t> &indices, int cacheSize) {
+	if (indices.size() < 3) {
+		return 0.f;
+	}
+	std::vector<uint32_t> fifo(cacheSize, NO_VERTEX);
+	int next = 0;
+	long long misses = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		bool hit = false;
+		for (int j = 0; j < cacheSize && !hit; j++) {
+			hit = fifo[j] == indices[i];
+		}
+		if (!hit) {
+			fifo[next] = indices[i];
+			next = (next + 1) % cacheSize;
+			misses++;
+		}
+	}
+	return (float)misses / (indices.size() / 3);
+}
+
+// NO_INDEX reads as zero
+static void copyVector(const std::vector<Vec3f> &values, uint32_t index, float *out) {
+	Vec3f value = index < values.size() ? values[index] : Vec3f(0, 0, 0);
+	out[0] = value.x;
+	out[1] = value.y;
+	out[2] = value.z;
+}
+
+// Order of the triangles of indices. Fans around one vertex at a time, the next one picked among the
+// vertices just used so that it will still be in the cache once all of its triangles are emitted,
+// and taken from the most recently used vertices when that fails
+static std::vector<uint32_t> tipsify(const std::vector<uint32_t> &indices, uint32_t vertexCount, int cacheSize) {
+	uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+	// Triangles around every vertex, the ones of vertex v are adjacency[adjacencyStart[v]] to adjacency[adjacencyStart[v + 1]]
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacencyStart[indices[i] + 1]++;
+	}
+	std::vector<int> liveTriangles(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		liveTriangles[v] = (int)adjacencyStart[v + 1];
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> order;
+	order.reserve(triangleCount);
+	int time = cacheSize + 1;
+	uint32_t cursor = 0;
+	int64_t fanning = vertexCount > 0 ? 0 : -1;
+	while (fanning >= 0) {
+		candidates.clear();
+		for (uint32_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++) {
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = indices[triangle * 3 + k];
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize) {
+					cacheTime[v] = time;
+					time++;
+				}
+			}
+			emitted[triangle] = true;
+			order.push_back(triangle);
+		}
+
+		// The candidate that stays in the cache the longest while its remaining triangles are drawn
+		fanning = -1;
+		int bestPriority = -1;
+		for (size_t i = 0; i < candidates.size(); i++) {
+			uint32_t v = candidates[i];
+			if (liveTriangles[v] <= 0) {
+				continue;
+			}
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+				priority = time - cacheTime[v];
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+		// Dead end, back to the last vertices used and then to the next unfinished one in index order
+		while (fanning < 0 && !deadEnd.empty()) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[v] > 0) {
+				fanning = v;
+			}
+		}
+		for (; fanning < 0 && cursor < vertexCount; cursor++) {
+			if (liveTriangles[cursor] > 0) {
+				fanning = cursor;
+			}
+		}
+	}
+	return order;
+}
+
+MeshOptimizerResult optimizeMesh(std::vector<Vec3f> &verts, std::vector<Vec3f> &vertTextures, std::vector<Vec3f> &vertNormals, std::vector<FaceCorner> &faceCorners) {
+	MeshOptimizerResult result;
+	result.sourceVertices = (int)verts.size();
+
+	// Welding, the unified vertices are numbered in the order the corners meet them
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> welded;
+	welded.reserve(verts.size() * 2);
+	std::vector<VertexKey> vertices;
+	std::vector<uint32_t> indices(faceCorners.size());
+	for (size_t i = 0; i < faceCorners.size(); i++) {
+		VertexKey key;
+		copyVector(verts, faceCorners[i].ivert, key.values);
+		copyVector(vertTextures, faceCorners[i].iuv, key.values + 3);
+		copyVector(vertNormals, faceCorners[i].inorm, key.values + 6);
+		key.missing = (faceCorners[i].iuv == NO_INDEX ? MISSING_TEXTURE : 0) | (faceCorners[i].inorm == NO_INDEX ? MISSING_NORMAL : 0);
+		std::pair<std::unordered_map<VertexKey, uint32_t, VertexKeyHash>::iterator, bool> inserted = welded.insert(std::make_pair(key, (uint32_t)vertices.size()));
+		if (inserted.second) {
+			vertices.push_back(key);
+		}
+		indices[i] = inserted.first->second;
+	}
+	result.weldedVertices = (int)vertices.size();
+	result.acmrBefore = computeAcmr(indices);
+
+	std::vector<uint32_t> order = tipsify(indices, (uint32_t)vertices.size(), VERTEX_CACHE_SIZE);
+	std::vector<uint32_t> reordered(indices.size());
+	for (size_t t = 0; t < order.size(); t++) {
+		for (int k = 0; k < 3; k++) {
+			reordered[t * 3 + k] = indices[order[t] * 3 + k];
+		}
+	}
+
+	// Vertices renumbered by first use, so the triangles read them mostly front to back
+	std::vector<uint32_t> remap(vertices.size(), NO_VERTEX);
+	uint32_t nextVertex = 0;
+	for (size_t i = 0; i < reordered.size(); i++) {
+		if (remap[reordered[i]] == NO_VERTEX) {
+			remap[reordered[i]] = nextVertex++;
+		}
+		reordered[i] = remap[reordered[i]];
+	}
+	result.acmrAfter = computeAcmr(reordered);
+
+	bool hasTextures = !vertTextures.empty();
+	bool hasNormals = !vertNormals.empty();
+	verts.assign(vertices.size(), Vec3f());
+	vertTextures.assign(hasTextures ? vertices.size() : 0, Vec3f());
+	vertNormals.assign(hasNormals ? vertices.size() : 0, Vec3f());
+	for (size_t v = 0; v < vertices.size(); v++) {
+		const float *values = vertices[v].values;
+		verts[remap[v]] = Vec3f(values[0], values[1], values[2]);
+		if (hasTextures) {
+			vertTextures[remap[v]] = Vec3f(values[3], values[4], values[5]);
+		}
+		if (hasNormals) {
+			vertNormals[remap[v]] = Vec3f(values[6], values[7], values[8]);
+		}
+	}
+	std::vector<uint32_t> missing(vertices.size());
+	for (size_t v = 0; v < vertices.size(); v++) {
+		missing[remap[v]] = vertices[v].missing;
+	}
+	for (size_t i = 0; i < reordered.size(); i++) {
+		uint32_t v = reordered[i];
+		faceCorners[i].ivert = v;
+		faceCorners[i].iuv = hasTextures && !(missing[v] & MISSING_TEXTURE) ? v : NO_INDEX;
+		faceCorners[i].inorm = hasNormals && !(missing[v] & MISSING_NORMAL) ? v : NO_INDEX;
+	}
+	return result;
+}
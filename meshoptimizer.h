@@ -0,0 +1,30 @@
+#ifndef __MESHOPTIMIZER_H__
+#define __MESHOPTIMIZER_H__
+
+#include <cstdint>
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+
+// Entries of the FIFO post-transform cache the triangle order is optimized and measured for
+const int VERTEX_CACHE_SIZE = 16;
+
+struct MeshOptimizerResult {
+	int sourceVertices;    // positions of the OBJ
+	int weldedVertices;    // different (position, uv, normal) tuples, the unified vertices
+	float acmrBefore;      // of the unified vertices in the OBJ face order
+	float acmrAfter;
+};
+
+// Average cache misses per triangle, the vertices a FIFO cache of cacheSize entries would have to transform.
+// 3 when nothing is reused, about 0.5 for a long regular strip
+float computeAcmr(const std::vector<uint32_t> &indices, int cacheSize=VERTEX_CACHE_SIZE);
+
+// Welds the corners with identical position, texture coordinate and normal into unified vertices, so every corner
+// ends up with the same index in the three arrays. Triangles are then reordered for the vertex cache with Tipsify
+// (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw") and the vertices
+// renumbered in the order the triangles first use them, which keeps the vertex fetches close together.
+// Arrays the OBJ had no values for stay empty, and the corners without a texture coordinate or normal keep NO_INDEX
+MeshOptimizerResult optimizeMesh(std::vector<Vec3f> &verts, std::vector<Vec3f> &vertTextures, std::vector<Vec3f> &vertNormals, std::vector<FaceCorner> &faceCorners);
+
+#endif //__MESHOPTIMIZER_H__
@@ -1,82 +1,568 @@
 #include <iostream>
-#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
 #include <fstream>
-#include <sstream>
+#include <string>
 #include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "model.h"
+#include "mappedfile.h"
+#include "meshoptimizer.h"
+#include "threadpool.h"
 
-Model::Model(const char *filename) : verts_(), faces_() {
-    std::ifstream in;
-    in.open (filename, std::ifstream::in);
-    if (in.fail()) return;
-    std::string line;
-    while (!in.eof()) {
-        std::getline(in, line);
-        std::istringstream iss(line.c_str());
-        std::string trash;
-        if (!line.compare(0, 2, "v ")) {
-            iss >> trash;
-            Vec3f v;
-            for (int i=0;i<3;i++) {
-                iss >> v.raw[i];
-            }
-            verts_.push_back(v);
-        } else if (!line.compare(0, 4, "vt  ")) {
-            iss >> trash;
-            Vec3f v;
-            for (int i=0;i<3;i++) {
-                iss >> v.raw[i];
+// Files bigger than this are split in chunks parsed on several threads
+const size_t OBJ_PARALLEL_CHUNK_SIZE = 8 << 20;
+
+// Marks an index that can't be right, such as 0 or a relative one going past the start of the file.
+// It is bigger than any array so the range check after loading rejects it
+const uint32_t INVALID_INDEX = 0xFFFFFFFE;
+
+// A negative OBJ index counts back from the elements read so far, which a chunk only knows for its own lines.
+// It is resolved as local from the start of its chunk and rebased once the chunks before are counted
+struct RelativeIndex {
+    size_t corner;    // in faceCorners of the chunk
+    int component;    // 0 vertex, 1 texture, 2 normal
+    long long local;
+};
+
+// Everything parsed out of a range of lines, chunks are appended in file order afterwards.
+// Positive OBJ indices are global to the file, only the relative ones need to be rebased when merging
+struct ObjChunk {
+    std::vector<Vec3f> verts;
+    std::vector<Vec3f> vertTextures;
+    std::vector<Vec3f> vertNormals;
+    std::vector<FaceCorner> faceCorners;
+    std::vector<RelativeIndex> relativeIndices;
+};
+
+// A face corner as read, before it goes in the chunk
+struct ParsedCorner {
+    FaceCorner corner;
+    int relativeMask;         // bit i set when component i was a negative index
+    long long relative[3];
+};
+
+// Layout of a .srmesh file: this header followed by the vertex, texture, normal and face corner
+// arrays, each one starting at an offset aligned to MESH_CACHE_ALIGNMENT. Everything is stored
+// in the in-memory (little endian) layout so the arrays can be used straight from the mapping
+const char MESH_CACHE_MAGIC[8] = { 'S', 'R', 'M', 'E', 'S', 'H', '\0', '\0' };
+const uint32_t MESH_CACHE_VERSION = 4;
+// Flags of the header
+const uint32_t MESH_CACHE_OPTIMIZED = 1;
+const int MESH_CACHE_BLOCKS = 4;
+const size_t MESH_CACHE_ALIGNMENT = 64;
+
+struct MeshCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t contentHash;    // hash of everything after the header
+    uint64_t fileSize;
+    uint32_t counts[MESH_CACHE_BLOCKS];
+    uint32_t flags;
+    float    acmrBefore;     // what optimizeMesh() measured, so it can be reported without redoing it
+    float    acmrAfter;
+    uint64_t offsets[MESH_CACHE_BLOCKS];
+    uint64_t sourceSize;     // of the OBJ when it was parsed, the cache is only used while both still match
+    int64_t  sourceTime;
+};
+
+static uint64_t hashMeshCache(const char *data, size_t size) {
+    // Word at a time multiply and xor-shift mix, fast enough to check the whole file on every load
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 0xC4CEB9FE1A85EC53ull;
+    }
+    return hash ^ (hash >> 33);
+}
+
+static std::string getMeshCachePath(const char *filename) {
+    std::string path(filename);
+    size_t extension = path.find_last_of('.');
+    size_t directory = path.find_last_of("/\\");
+    if (extension != std::string::npos && (directory == std::string::npos || extension > directory)) {
+        path.erase(extension);
+    }
+    return path + ".srmesh";
+}
+
+// Compared for equality rather than ordered against the cache's own time, whole second timestamps
+// can't tell an OBJ written in the same second as its cache apart from an older one
+static bool getMeshSourceStamp(const char *sourcePath, MeshSourceStamp &stamp) {
+    struct stat sourceInfo;
+    if (stat(sourcePath, &sourceInfo) != 0) {
+        return false;
+    }
+    stamp.size = (uint64_t)sourceInfo.st_size;
+    stamp.time = (int64_t)sourceInfo.st_mtime;
+    return true;
+}
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline void skipBlanks(const char *&p, const char *end) {
+    while (p < end && isBlank(*p)) p++;
+}
+
+// Locale independent decimal parser, the digits are accumulated as an integer and
+// scaled once by an exact power of ten, which is enough for the precision of a float
+static bool parseFloat(const char *&p, const char *end, float &value) {
+    static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    skipBlanks(p, end);
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    const char *digitsStart = p;
+    for (; p < end && isDigit(*p); p++) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+    bool sawDigits = p != digitsStart;
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            sawDigits = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
             }
-            vertTextures_.push_back(v);
-        } else if (!line.compare(0, 4, "vn  ")) {
-            iss >> trash;
-            Vec3f v;
-            for (int i=0;i<3;i++) {
-                iss >> v.raw[i];
+        }
+    }
+    if (!sawDigits) {
+        p = start;
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *exponentStart = p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        if (p < end && isDigit(*p)) {
+            int e = 0;
+            for (; p < end && isDigit(*p); p++) {
+                if (e < 10000) e = e * 10 + (*p - '0');
             }
-            vertNormals_.push_back(v);
-        } else if (!line.compare(0, 2, "f ")) {
-            std::vector<std::vector<int>> f;
-            int idx, idy, idz;
-            char ctrash;
-            iss >> ctrash;
-            while (iss >> idx >> ctrash >> idy >> ctrash >> idz) {
-                // idx--; // in wavefront obj all indices start at 1, not zero
-                // idy--;
-                // idz--;
-                std::vector<int> faceVertex{ --idx, --idy, --idz };
-                f.push_back(faceVertex);
+            exponent += negativeExponent ? -e : e;
+        } else {
+            p = exponentStart;
+        }
+    }
+    double result = (double)mantissa;
+    if (mantissa != 0) {
+        while (exponent > 22) { result *= 1e22; exponent -= 22; }
+        while (exponent < -22) { result /= 1e22; exponent += 22; }
+        result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+    }
+    value = (float)(negative ? -result : result);
+    return true;
+}
+
+static bool parseInt(const char *&p, const char *end, int &value) {
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p >= end || !isDigit(*p)) {
+        return false;
+    }
+    int result = 0;
+    for (; p < end && isDigit(*p); p++) {
+        // saturates instead of overflowing, anything this big is out of range anyway
+        result = result < 100000000 ? result * 10 + (*p - '0') : 1000000000;
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+// Reads a "v/vt/vn" triplet, the texture and normal indices can be left out as in "v", "v/vt" or "v//vn".
+// Missing ones become NO_INDEX, negative ones are relative to what chunk has read so far
+static bool parseFaceCorner(const char *&p, const char *end, const ObjChunk &chunk, ParsedCorner &parsed) {
+    int index[3] = { 0, 0, 0 };
+    bool present[3] = { false, false, false };
+    skipBlanks(p, end);
+    if (!parseInt(p, end, index[0])) {
+        return false;
+    }
+    present[0] = true;
+    for (int i = 1; i < 3 && p < end && *p == '/'; i++) {
+        p++;
+        present[i] = parseInt(p, end, index[i]);
+    }
+    const size_t counts[3] = { chunk.verts.size(), chunk.vertTextures.size(), chunk.vertNormals.size() };
+    uint32_t *resolved[3] = { &parsed.corner.ivert, &parsed.corner.iuv, &parsed.corner.inorm };
+    parsed.relativeMask = 0;
+    for (int i = 0; i < 3; i++) {
+        parsed.relative[i] = 0;
+        if (!present[i]) {
+            *resolved[i] = NO_INDEX;
+        } else if (index[i] > 0) {
+            // in wavefront obj all indices start at 1, not zero
+            *resolved[i] = (uint32_t)(index[i] - 1);
+        } else if (index[i] < 0) {
+            parsed.relativeMask |= 1 << i;
+            parsed.relative[i] = (long long)counts[i] + index[i];
+            *resolved[i] = INVALID_INDEX;
+        } else {
+            *resolved[i] = INVALID_INDEX;
+        }
+    }
+    return true;
+}
+
+static void appendCorner(ObjChunk &chunk, const ParsedCorner &parsed) {
+    for (int i = 0; i < 3; i++) {
+        if (parsed.relativeMask & (1 << i)) {
+            RelativeIndex relative = { chunk.faceCorners.size(), i, parsed.relative[i] };
+            chunk.relativeIndices.push_back(relative);
+        }
+    }
+    chunk.faceCorners.push_back(parsed.corner);
+}
+
+// Rebases the relative indices of a chunk whose elements start at base in the merged arrays
+static void resolveRelativeIndices(ObjChunk &chunk, const size_t base[3]) {
+    for (size_t i = 0; i < chunk.relativeIndices.size(); i++) {
+        const RelativeIndex &relative = chunk.relativeIndices[i];
+        long long index = (long long)base[relative.component] + relative.local;
+        uint32_t value = index >= 0 && index < (long long)INVALID_INDEX ? (uint32_t)index : INVALID_INDEX;
+        FaceCorner &corner = chunk.faceCorners[relative.corner];
+        (relative.component == 0 ? corner.ivert : relative.component == 1 ? corner.iuv : corner.inorm) = value;
+    }
+}
+
+// True when every corner points inside the arrays, NO_INDEX being allowed for the texture and normal
+static bool areFaceCornersValid(const FaceCorner *corners, size_t count, uint32_t verts, uint32_t textures, uint32_t normals) {
+    for (size_t i = 0; i < count; i++) {
+        if (corners[i].ivert >= verts
+            || (corners[i].iuv != NO_INDEX && corners[i].iuv >= textures)
+            || (corners[i].inorm != NO_INDEX && corners[i].inorm >= normals)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static Vec3f parseVector(const char *p, const char *end) {
+    Vec3f v;
+    for (int i = 0; i < 3 && parseFloat(p, end, v.raw[i]); i++) {
+    }
+    return v;
+}
+
+static void parseObjLines(const char *begin, const char *end, ObjChunk &chunk) {
+    const char *line = begin;
+    while (line < end) {
+        const char *lineEnd = (const char *)memchr(line, '\n', end - line);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        const char *p = line;
+        skipBlanks(p, lineEnd);
+        // the keyword can be followed by any amount of spaces, "vt 0.5" and "vt  0.5" are both valid
+        if (lineEnd - p > 1 && p[0] == 'v' && isBlank(p[1])) {
+            chunk.verts.push_back(parseVector(p + 2, lineEnd));
+        } else if (lineEnd - p > 2 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+            chunk.vertTextures.push_back(parseVector(p + 3, lineEnd));
+        } else if (lineEnd - p > 2 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+            chunk.vertNormals.push_back(parseVector(p + 3, lineEnd));
+        } else if (lineEnd - p > 1 && p[0] == 'f' && isBlank(p[1])) {
+            // polygons with more than 3 corners are split in a triangle fan around the first one
+            p += 2;
+            ParsedCorner first, previous, current;
+            int corners = 0;
+            while (parseFaceCorner(p, lineEnd, chunk, current)) {
+                if (corners == 0) {
+                    first = current;
+                } else if (corners >= 2) {
+                    appendCorner(chunk, first);
+                    appendCorner(chunk, previous);
+                    appendCorner(chunk, current);
+                }
+                previous = current;
+                corners++;
             }
-            faces_.push_back(f);
         }
+        line = lineEnd + 1;
+    }
+}
+
+Model::Model(const char *filename, bool useMeshCache, bool optimize) : verts_(), faceCorners_(), optimized_(false), acmrBefore_(0), acmrAfter_(0) {
+    std::string cachePath = getMeshCachePath(filename);
+    // Taken before parsing, an OBJ that changes in the meantime won't match the cache next time
+    MeshSourceStamp source;
+    bool hasSource = getMeshSourceStamp(filename, source);
+    if (useMeshCache && loadMeshCache(cachePath.c_str(), optimize, hasSource ? &source : NULL)) {
+        std::cerr << "# v# " << verts_.size << " vt# " << vertTextures_.size << " vn# " << vertNormals_.size << " f# "  << getTotalFaces() << " (" << cachePath << ")" << std::endl;
+        if (optimized_) {
+            std::cerr << "# acmr " << acmrBefore_ << " -> " << acmrAfter_ << std::endl;
+        }
+        return;
     }
-    std::cerr << "# v# " << verts_.size() << " vt# " << vertTextures_.size() << " vn# " << vertNormals_.size() << " f# "  << faces_.size() << std::endl;
+    loadObj(filename);
+    std::cerr << "# v# " << verts_.size << " vt# " << vertTextures_.size << " vn# " << vertNormals_.size << " f# "  << getTotalFaces() << std::endl;
+    if (optimize && faceCorners_.size > 0) {
+        this->optimize();
+    }
+    if (useMeshCache && hasSource && verts_.size > 0 && !writeMeshCache(cachePath.c_str(), source)) {
+        std::cerr << "can't write the mesh cache " << cachePath << "\n";
+    }
+}
+
+void Model::loadObj(const char *filename) {
+    MappedFile file;
+    if (!file.open(filename)) return;
+    const char *begin = file.getData();
+    const char *end = begin + file.getSize();
+
+    int totalChunks = (int)std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), file.getSize() / OBJ_PARALLEL_CHUNK_SIZE + 1);
+    if (totalChunks <= 1) {
+        ObjChunk chunk;
+        parseObjLines(begin, end, chunk);
+        const size_t base[3] = { 0, 0, 0 };
+        resolveRelativeIndices(chunk, base);
+        vertsStorage_.swap(chunk.verts);
+        vertTexturesStorage_.swap(chunk.vertTextures);
+        vertNormalsStorage_.swap(chunk.vertNormals);
+        faceCornersStorage_.swap(chunk.faceCorners);
+    } else {
+        // Split in roughly equal ranges, moving every boundary forward to the next line start
+        std::vector<const char *> boundaries(totalChunks + 1, end);
+        boundaries[0] = begin;
+        for (int i = 1; i < totalChunks; i++) {
+            const char *boundary = std::max(boundaries[i - 1], begin + file.getSize() / totalChunks * i);
+            const char *newline = (const char *)memchr(boundary, '\n', end - boundary);
+            boundaries[i] = newline ? newline + 1 : end;
+        }
+        std::vector<ObjChunk> chunks(totalChunks);
+        ThreadPool workers(totalChunks);
+        workers.parallelFor(totalChunks, [&](int i) {
+            parseObjLines(boundaries[i], boundaries[i + 1], chunks[i]);
+        });
+
+        size_t totalVerts = 0, totalTextures = 0, totalNormals = 0, totalCorners = 0;
+        for (int i = 0; i < totalChunks; i++) {
+            totalVerts += chunks[i].verts.size();
+            totalTextures += chunks[i].vertTextures.size();
+            totalNormals += chunks[i].vertNormals.size();
+            totalCorners += chunks[i].faceCorners.size();
+        }
+        vertsStorage_.reserve(totalVerts);
+        vertTexturesStorage_.reserve(totalTextures);
+        vertNormalsStorage_.reserve(totalNormals);
+        faceCornersStorage_.reserve(totalCorners);
+        for (int i = 0; i < totalChunks; i++) {
+            const size_t base[3] = { vertsStorage_.size(), vertTexturesStorage_.size(), vertNormalsStorage_.size() };
+            resolveRelativeIndices(chunks[i], base);
+            vertsStorage_.insert(vertsStorage_.end(), chunks[i].verts.begin(), chunks[i].verts.end());
+            vertTexturesStorage_.insert(vertTexturesStorage_.end(), chunks[i].vertTextures.begin(), chunks[i].vertTextures.end());
+            vertNormalsStorage_.insert(vertNormalsStorage_.end(), chunks[i].vertNormals.begin(), chunks[i].vertNormals.end());
+            faceCornersStorage_.insert(faceCornersStorage_.end(), chunks[i].faceCorners.begin(), chunks[i].faceCorners.end());
+        }
+    }
+    if (!areFaceCornersValid(faceCornersStorage_.data(), faceCornersStorage_.size(), (uint32_t)vertsStorage_.size(), (uint32_t)vertTexturesStorage_.size(), (uint32_t)vertNormalsStorage_.size())) {
+        // Left empty, as a file that can't be read
+        std::cerr << "face index out of range in " << filename << "\n";
+        vertsStorage_.clear();
+        vertTexturesStorage_.clear();
+        vertNormalsStorage_.clear();
+        faceCornersStorage_.clear();
+    }
+    verts_ = MeshArray<Vec3f>(vertsStorage_);
+    vertTextures_ = MeshArray<Vec3f>(vertTexturesStorage_);
+    vertNormals_ = MeshArray<Vec3f>(vertNormalsStorage_);
+    faceCorners_ = MeshArray<FaceCorner>(faceCornersStorage_);
+}
+
+void Model::optimize() {
+    MeshOptimizerResult result = optimizeMesh(vertsStorage_, vertTexturesStorage_, vertNormalsStorage_, faceCornersStorage_);
+    verts_ = MeshArray<Vec3f>(vertsStorage_);
+    vertTextures_ = MeshArray<Vec3f>(vertTexturesStorage_);
+    vertNormals_ = MeshArray<Vec3f>(vertNormalsStorage_);
+    faceCorners_ = MeshArray<FaceCorner>(faceCornersStorage_);
+    optimized_ = true;
+    acmrBefore_ = result.acmrBefore;
+    acmrAfter_ = result.acmrAfter;
+    std::cerr << "# welded " << result.sourceVertices << " positions into " << result.weldedVertices << " vertices, acmr " << acmrBefore_ << " -> " << acmrAfter_ << std::endl;
+}
+
+bool Model::loadMeshCache(const char *filename, bool optimize, const MeshSourceStamp *source) {
+    if (!meshCache_.open(filename)) {
+        return false;
+    }
+    const char *data = meshCache_.getData();
+    size_t size = meshCache_.getSize();
+    MeshCacheHeader header;
+    if (size < sizeof(header)) {
+        meshCache_.close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    bool valid = !memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic))
+        && header.version == MESH_CACHE_VERSION
+        && header.headerSize == sizeof(header)
+        && header.fileSize == size;
+    const size_t elementSizes[MESH_CACHE_BLOCKS] = { sizeof(Vec3f), sizeof(Vec3f), sizeof(Vec3f), sizeof(FaceCorner) };
+    for (int i = 0; valid && i < MESH_CACHE_BLOCKS; i++) {
+        valid = header.offsets[i] % MESH_CACHE_ALIGNMENT == 0
+            && header.offsets[i] >= sizeof(header)
+            && header.offsets[i] <= size
+            && header.counts[i] <= (size - header.offsets[i]) / elementSizes[i];
+    }
+    valid = valid && header.counts[3] % VERTICES_PER_FACE == 0
+        && hashMeshCache(data + sizeof(header), size - sizeof(header)) == header.contentHash;
+    // The hash only tells the file wasn't damaged, the mesh is indexed without checks afterwards
+    // so every corner is checked against the arrays once here
+    valid = valid && areFaceCornersValid((const FaceCorner *)(data + header.offsets[3]), header.counts[3], header.counts[0], header.counts[1], header.counts[2]);
+    if (!valid) {
+        std::cerr << "ignoring invalid or outdated mesh cache " << filename << "\n";
+        meshCache_.close();
+        return false;
+    }
+    // Valid but made from another OBJ or for the other setting, the caller parses the OBJ again and replaces it
+    bool outdated = source != NULL && (header.sourceSize != source->size || header.sourceTime != source->time);
+    if (outdated || ((header.flags & MESH_CACHE_OPTIMIZED) != 0) != optimize) {
+        meshCache_.close();
+        return false;
+    }
+    optimized_ = optimize;
+    acmrBefore_ = header.acmrBefore;
+    acmrAfter_ = header.acmrAfter;
+    // The arrays are used in place, nothing is copied out of the mapping
+    verts_ = MeshArray<Vec3f>((const Vec3f *)(data + header.offsets[0]), header.counts[0]);
+    vertTextures_ = MeshArray<Vec3f>((const Vec3f *)(data + header.offsets[1]), header.counts[1]);
+    vertNormals_ = MeshArray<Vec3f>((const Vec3f *)(data + header.offsets[2]), header.counts[2]);
+    faceCorners_ = MeshArray<FaceCorner>((const FaceCorner *)(data + header.offsets[3]), header.counts[3]);
+    return true;
+}
+
+bool Model::writeMeshCache(const char *filename, const MeshSourceStamp &source) {
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.headerSize = sizeof(header);
+    header.flags = optimized_ ? MESH_CACHE_OPTIMIZED : 0;
+    header.acmrBefore = acmrBefore_;
+    header.acmrAfter = acmrAfter_;
+    header.sourceSize = source.size;
+    header.sourceTime = source.time;
+
+    const char *blocks[MESH_CACHE_BLOCKS] = { (const char *)verts_.data, (const char *)vertTextures_.data, (const char *)vertNormals_.data, (const char *)faceCorners_.data };
+    const size_t blockSizes[MESH_CACHE_BLOCKS] = { verts_.size * sizeof(Vec3f), vertTextures_.size * sizeof(Vec3f), vertNormals_.size * sizeof(Vec3f), faceCorners_.size * sizeof(FaceCorner) };
+    const uint32_t counts[MESH_CACHE_BLOCKS] = { verts_.size, vertTextures_.size, vertNormals_.size, faceCorners_.size };
+    size_t offset = sizeof(header);
+    for (int i = 0; i < MESH_CACHE_BLOCKS; i++) {
+        offset = (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+        header.counts[i] = counts[i];
+        header.offsets[i] = offset;
+        offset += blockSizes[i];
+    }
+    header.fileSize = offset;
+
+    // Built in memory first so the hash covers exactly the bytes that end up on disk
+    std::vector<char> content(offset, 0);
+    for (int i = 0; i < MESH_CACHE_BLOCKS; i++) {
+        if (blockSizes[i] > 0) {
+            memcpy(&content[header.offsets[i]], blocks[i], blockSizes[i]);
+        }
+    }
+    header.contentHash = hashMeshCache(&content[sizeof(header)], content.size() - sizeof(header));
+    memcpy(&content[0], &header, sizeof(header));
+
+    // Written next to the final name and renamed, so a reader never maps a half written file
+    std::string temporaryName = std::string(filename) + ".tmp";
+    std::ofstream out;
+    out.open(temporaryName.c_str(), std::ios::binary);
+    if (!out.is_open()) {
+        return false;
+    }
+    out.write(&content[0], content.size());
+    out.close();
+    if (!out.good()) {
+        std::remove(temporaryName.c_str());
+        return false;
+    }
+    std::remove(filename);
+    if (std::rename(temporaryName.c_str(), filename) != 0) {
+        std::remove(temporaryName.c_str());
+        return false;
+    }
+    return true;
 }
 
 Model::~Model() {
 }
 
+size_t Model::getMemoryUsage() const {
+    return sizeof(Model) + meshCache_.getSize()
+        + (vertsStorage_.capacity() + vertTexturesStorage_.capacity() + vertNormalsStorage_.capacity()) * sizeof(Vec3f)
+        + faceCornersStorage_.capacity() * sizeof(FaceCorner);
+}
+
 int Model::getTotalVertices() {
-    return (int)verts_.size();
+    return (int)verts_.size;
 }
 
 int Model::getTotalTextureVertices() {
-    return (int)vertTextures_.size();
+    return (int)vertTextures_.size;
+}
+
+int Model::getTotalNormals() {
+    return (int)vertNormals_.size;
 }
 
 int Model::getTotalFaces() {
-    return (int)faces_.size();
+    return (int)faceCorners_.size / VERTICES_PER_FACE;
 }
 
-std::vector<std::vector<int>> Model::getFaceByIndex(int idx) {
-    return faces_[idx];
+const FaceCorner* Model::getFaceByIndex(int idx) {
+    return &faceCorners_[idx * VERTICES_PER_FACE];
 }
 
-Vec3f Model::getVertexByIndex(int i) {
+const Vec3f& Model::getVertexByIndex(int i) {
     return verts_[i];
 }
 
-Vec3f Model::getTextureVertexByIndex(int i) {
+const Vec3f* Model::getVertices() {
+    return verts_.data;
+}
+
+const Vec3f& Model::getTextureVertexByIndex(int i) {
     return vertTextures_[i];
 }
 
+const Vec3f& Model::getNormalByIndex(int i) {
+    return vertNormals_[i];
+}
+
@@ -1,24 +1,90 @@
 #ifndef __MODEL_H__
 #define __MODEL_H__
 
+#include <cstdint>
 #include <vector>
 #include "geometry.h"
+#include "mappedfile.h"
+
+// iuv and inorm of the corners the OBJ gives no texture coordinate or normal for
+const uint32_t NO_INDEX = 0xFFFFFFFF;
+
+// Indices of one face corner into the vertex, texture and normal arrays. A loaded model only has
+// indices inside its arrays, apart from iuv and inorm being NO_INDEX
+struct FaceCorner {
+	uint32_t ivert, iuv, inorm;
+};
+
+// Size and modification time of the OBJ a .srmesh cache was written from
+struct MeshSourceStamp {
+	uint64_t size;
+	int64_t time;
+};
+
+// Read only view over one of the mesh arrays, it points either into the vectors
+// filled by the OBJ parser or straight into a memory mapped .srmesh cache
+template <class t> struct MeshArray {
+	const t* data;
+	uint32_t size;
+
+	MeshArray() : data(NULL), size(0) {}
+	MeshArray(const std::vector<t>& v) : data(v.data()), size((uint32_t)v.size()) {}
+	MeshArray(const t* d, uint32_t s) : data(d), size(s) {}
+	const t& operator[](const size_t i) const { return data[i]; }
+};
 
 class Model {
 private:
-	std::vector<Vec3f> verts_;
-	std::vector<Vec3f> vertTextures_;
-	std::vector<Vec3f> vertNormals_;
-	std::vector<std::vector<std::vector<int>> > faces_;
+	// Filled when the mesh is parsed from the OBJ text, empty when it comes from the cache
+	std::vector<Vec3f> vertsStorage_;
+	std::vector<Vec3f> vertTexturesStorage_;
+	std::vector<Vec3f> vertNormalsStorage_;
+	std::vector<FaceCorner> faceCornersStorage_;
+	MappedFile meshCache_;
+
+	MeshArray<Vec3f> verts_;
+	MeshArray<Vec3f> vertTextures_;
+	MeshArray<Vec3f> vertNormals_;
+	// Every face is a triangle stored as 3 consecutive corners, polygons are split into fans on load
+	MeshArray<FaceCorner> faceCorners_;
+	// Set when the mesh went through optimizeMesh(), with the vertex cache misses per triangle before and after
+	bool optimized_;
+	float acmrBefore_;
+	float acmrAfter_;
+
+	void loadObj(const char *filename);
+	void optimize();
+	// False as well when the cache was written with the other optimize setting or from another version
+	// of the OBJ. source is NULL when the OBJ is gone, then the cache is all there is
+	bool loadMeshCache(const char *filename, bool optimize, const MeshSourceStamp *source);
+	bool writeMeshCache(const char *filename, const MeshSourceStamp &source);
 public:
-	Model(const char *filename);
+	static const int VERTICES_PER_FACE = 3;
+
+	// With useMeshCache the parsed mesh is saved next to the OBJ as a .srmesh file, and later runs
+	// map that file instead of parsing the text again as long as the OBJ keeps its size and modification time.
+	// With optimize the corners are welded into unified vertices and reordered for the vertex cache
+	// (see optimizeMesh), and that is what the cache keeps
+	Model(const char *filename, bool useMeshCache=true, bool optimize=false);
 	~Model();
 	int getTotalVertices();
 	int getTotalFaces();
 	int getTotalTextureVertices();
-	Vec3f getVertexByIndex(int i);
-	std::vector<std::vector<int>> getFaceByIndex(int idx);
-	Vec3f getTextureVertexByIndex(int i);
+	int getTotalNormals();
+	const Vec3f& getVertexByIndex(int i);
+	const Vec3f* getVertices();
+	// Points to the VERTICES_PER_FACE corners of the face, valid as long as the model is alive
+	const FaceCorner* getFaceByIndex(int idx);
+	const Vec3f& getTextureVertexByIndex(int i);
+	const Vec3f& getNormalByIndex(int i);
+	// Bytes held by the parsed arrays, or by the mapping when the mesh comes from the cache
+	size_t getMemoryUsage() const;
+	bool isOptimized() const { return optimized_; }
+	// True when the arrays are mapped from the .srmesh cache instead of parsed from the OBJ
+	bool isFromMeshCache() const { return meshCache_.isOpen(); }
+	// Average cache misses per triangle of the OBJ order and of the optimized one, 0 unless optimized
+	float getAcmrBefore() const { return acmrBefore_; }
+	float getAcmrAfter() const { return acmrAfter_; }
 };
 
 #endif //__MODEL_H__
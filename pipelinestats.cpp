@@ -0,0 +1,67 @@
+#include <sstream>
+#include "pipelinestats.h"
+
+static const char *STAGE_NAMES[FrameStats::TOTAL_STAGES] = {
+	"clear", "vertex", "setup", "prepass", "raster", "shade", "encode"
+};
+
+static const char *COUNTER_NAMES[FrameStats::TOTAL_COUNTERS] = {
+	"triangles_submitted", "triangles_frustum_culled", "triangles_backface_culled", "triangles_culled",
+	"triangles_clipped", "triangles_rasterized", "triangles_hiz_culled",
+	"pixels_tested", "pixels_depth_failed", "pixels_written", "pixels_shaded", "pixels_shading_saved", "pixels_covered",
+	"bytes_encoded"
+};
+
+FrameStats::FrameStats() : frame(0) {
+	for (int i = 0; i < TOTAL_STAGES; i++) {
+		milliseconds[i] = 0;
+	}
+	for (int i = 0; i < TOTAL_COUNTERS; i++) {
+		counters[i] = 0;
+	}
+}
+
+std::string FrameStats::toJson() const {
+	std::ostringstream json;
+	json << "{\"frame\": " << frame << ", \"stages_ms\": {";
+	double total = 0;
+	for (int i = 0; i < TOTAL_STAGES; i++) {
+		json << (i > 0 ? ", " : "") << "\"" << STAGE_NAMES[i] << "\": " << milliseconds[i];
+		total += milliseconds[i];
+	}
+	json << ", \"total\": " << total << "}, \"counters\": {";
+	for (int i = 0; i < TOTAL_COUNTERS; i++) {
+		json << (i > 0 ? ", " : "") << "\"" << COUNTER_NAMES[i] << "\": " << counters[i];
+	}
+	// How many times every covered pixel was written on average, 1 is no overdraw at all
+	double overdraw = counters[PIXELS_COVERED] > 0 ? (double)counters[PIXELS_WRITTEN] / counters[PIXELS_COVERED] : 0.;
+	// fragment() calls per covered pixel, the part of the overdraw that costs shading
+	double shading = counters[PIXELS_COVERED] > 0 ? (double)counters[PIXELS_SHADED] / counters[PIXELS_COVERED] : 0.;
+	json << "}, \"overdraw_ratio\": " << overdraw << ", \"shading_ratio\": " << shading << "}";
+	return json.str();
+}
+
+PipelineStats::PipelineStats() {
+	reset();
+}
+
+void PipelineStats::reset() {
+	for (int i = 0; i < FrameStats::TOTAL_STAGES; i++) {
+		nanoseconds[i] = 0;
+	}
+	for (int i = 0; i < FrameStats::TOTAL_COUNTERS; i++) {
+		counters[i] = 0;
+	}
+}
+
+FrameStats PipelineStats::snapshot(int frame) const {
+	FrameStats stats;
+	stats.frame = frame;
+	for (int i = 0; i < FrameStats::TOTAL_STAGES; i++) {
+		stats.milliseconds[i] = nanoseconds[i] / 1e6;
+	}
+	for (int i = 0; i < FrameStats::TOTAL_COUNTERS; i++) {
+		stats.counters[i] = counters[i];
+	}
+	return stats;
+}
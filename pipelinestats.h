@@ -0,0 +1,82 @@
+#ifndef __PIPELINESTATS_H__
+#define __PIPELINESTATS_H__
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Plain copy of the numbers of one frame, taken once it is drawn so the next frame can start
+// counting while this one is still being encoded
+struct FrameStats {
+	enum Stage {
+		STAGE_CLEAR,     // color, depth and HiZ buffers back to the background
+		STAGE_VERTEX,    // every model vertex to screen space
+		STAGE_SETUP,     // face(), vertex() and bounding boxes of every triangle, and their front to back sort
+		STAGE_PREPASS,   // the depth only pass ahead of the raster stage when there is one
+		STAGE_RASTER,    // binning, coverage, depth test and shading, they run interleaved per pixel
+		STAGE_SHADE,     // the visibility buffer shading every visible pixel once, the raster stage is then depth only
+		STAGE_ENCODE,    // the finished frame to a file in memory
+		TOTAL_STAGES
+	};
+	enum Counter {
+		TRIANGLES_SUBMITTED,
+		TRIANGLES_FRUSTUM_CULLED,   // the three corners past the same side of the screen or behind the near plane
+		TRIANGLES_BACKFACE_CULLED,  // facing away from the eye, or with no area on the screen
+		TRIANGLES_CULLED,        // dropped by face(), the lit shaders drop the faces turned away from the light
+		TRIANGLES_CLIPPED,       // crossed the near plane or the guard band and went through the clipper
+		TRIANGLES_RASTERIZED,    // handed to the rasterizer, the pieces of the clipped ones included
+		TRIANGLES_HIZ_CULLED,    // dropped whole by the HiZ test, in every tile they were binned into. The pre-pass isn't counted
+		PIXELS_TESTED,           // inside a triangle and depth tested
+		PIXELS_DEPTH_FAILED,
+		PIXELS_WRITTEN,          // the depth only writes of a pre-pass included
+		PIXELS_SHADED,           // calls to fragment()
+		PIXELS_SHADING_SAVED,    // pixels the visibility buffer didn't shade that the forward path would have
+		PIXELS_COVERED,          // different pixels written at least once, the base of the overdraw ratio
+		BYTES_ENCODED,
+		TOTAL_COUNTERS
+	};
+
+	int frame;
+	double milliseconds[TOTAL_STAGES];
+	long long counters[TOTAL_COUNTERS];
+
+	FrameStats();
+	// A single line JSON object
+	std::string toJson() const;
+};
+
+// Counters of the frame being drawn. The tile workers add to them once per tile, not per pixel
+class PipelineStats {
+private:
+	std::atomic<long long> nanoseconds[FrameStats::TOTAL_STAGES];
+	std::atomic<long long> counters[FrameStats::TOTAL_COUNTERS];
+public:
+	PipelineStats();
+	void reset();
+	void add(FrameStats::Counter counter, long long value) { counters[counter] += value; }
+	void addTime(FrameStats::Stage stage, std::chrono::steady_clock::duration time) {
+		nanoseconds[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+	}
+	FrameStats snapshot(int frame) const;
+};
+
+// Adds the time until the end of the scope to a stage. With NULL stats the clock isn't even read
+class StageTimer {
+private:
+	PipelineStats *stats;
+	FrameStats::Stage stage;
+	std::chrono::steady_clock::time_point start;
+public:
+	StageTimer(PipelineStats *stats, FrameStats::Stage stage) : stats(stats), stage(stage) {
+		if (stats != NULL) {
+			start = std::chrono::steady_clock::now();
+		}
+	}
+	~StageTimer() {
+		if (stats != NULL) {
+			stats->addTime(stage, std::chrono::steady_clock::now() - start);
+		}
+	}
+};
+
+#endif //__PIPELINESTATS_H__
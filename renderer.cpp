@@ -0,0 +1,1125 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <string>
+#include <atomic>
+#include "geometry.h"
+#include "gl_util.h"
+#include "shaders.h"
+#include "renderer.h"
+
+// Side in pixels of the square screen tiles the triangles are binned into
+const int TILE_SIZE = 64;
+// Side in pixels of the blocks the edge function rasterizer accepts or rejects as a whole,
+// it matches the HiZ tiles so a block can be checked against a single coarse depth
+const int RASTER_BLOCK_SIZE = HiZBuffer::TILE_SIZE;
+
+int screenWidth = 0;
+int screenHeight = 0;
+float *zBuffer = NULL;
+Vec2i clamp;
+Model *model = NULL;
+Texture *diffuseTexture = NULL;
+ThreadPool *renderWorkers = NULL;
+RasterizerMode rasterizerMode = RASTERIZER_EDGE_FUNCTION;
+GammaLut *gammaLut = NULL;
+HiZBuffer *hiZBuffer = NULL;
+PipelineStats *pipelineStats = NULL;
+bool backfaceCulling = true;
+bool visibilityBuffer = false;
+bool frontToBack = false;
+bool depthPrepass = false;
+
+Vec3f eye(1,1, 3);
+Vec3f center(0,0,0);
+Vec3f up(0,1,0);
+Vec3f camera(0,0,1000);
+Vec3f lightDirection(0,0,-1);
+
+Mat4f viewport;
+Mat4f modelView = Util::generateModelView(eye, center, up);
+Mat4f projection = Util::getProjection(camera);
+
+std::vector<Vec3f> screenVertices;
+std::vector<Vec4f> clipVertices;
+std::vector<uint16_t> clipCodes;
+std::vector<uint32_t> triangleIds;
+
+void setResolution(int width, int height) {
+	screenWidth = width;
+	screenHeight = height;
+	delete[] zBuffer;
+	zBuffer = new float[width * height];
+	clamp = Vec2i(width - 1, height - 1);
+	viewport = Util::getViewport(width, height, DEPTH);
+	if (hiZBuffer != NULL) {
+		delete hiZBuffer;
+		hiZBuffer = new HiZBuffer(width, height);
+	}
+}
+
+bool parseShadingMode(const std::string &name, ShadingMode &mode) {
+	const char *names[] = { "texture", "gouraud", "gradient", "flat", "random" };
+	const ShadingMode modes[] = { SHADING_TEXTURE, SHADING_GOURAUD, SHADING_GRADIENT, SHADING_FLAT, SHADING_RANDOM };
+	for (int i = 0; i < 5; i++) {
+		if (name == names[i]) {
+			mode = modes[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<Vec2f> drawLine(int x0, int y0, int x1, int y1, Framebuffer &framebuffer, PackedColor color) {
+	std::vector<Vec2f> linePoints;
+	
+	bool steep = false; 
+	if (std::abs(x0-x1) < std::abs(y0-y1)) {  // if the line is steep, we transpose the image 
+		std::swap(x0, y0); 
+		std::swap(x1, y1); 
+		steep = true; 
+	} 
+	if (x0 > x1) { // make it left−to−right 
+		std::swap(x0, x1); 
+		std::swap(y0, y1); 
+	} 
+	int dx = x1-x0; 
+	int dy = y1-y0; 
+	int derror2 = std::abs(dy)*2; 
+	int error2 = 0; 
+	int y = y0; 
+	for (int x=x0; x <= x1; x++) { 
+		if (steep) {
+			linePoints.push_back(Vec2f(y, x));
+			if (framebuffer.contains(y, x)) {
+				framebuffer.set(y, x, color); // if transposed, de−transpose 
+			}
+		} else {
+			linePoints.push_back(Vec2f(x, y));
+			if (framebuffer.contains(x, y)) {
+				framebuffer.set(x, y, color); 
+			}
+		} 
+		error2 += derror2; 
+		if (error2 > dx) { 
+			y += (y1 > y0 ? 1 : -1); 
+			error2 -= dx*2; 
+		} 
+	}
+
+	return linePoints;
+} 
+
+Vec3f getBarycentricVector(const Vec3f *triangleVertex, Vec3f P) {
+	// This calculation comes from a linear system of equations when considering u + v + w = 1 in barycentric coordinate theory
+	// The result is a vector [u, v, 1] that is perpendicular to (ACx, ABx, PAx) and (ACy, ABy, PAy)
+	// (ACx, ABx, PAx) cross product (ACy, ABy, PAy) should give us the normal vector, with a z value that must be 1
+	// if not, P doesn't belong in this triangle 
+	Vec3f barycentricWeight = Vec3f(triangleVertex[2].x-triangleVertex[0].x, triangleVertex[1].x-triangleVertex[0].x, triangleVertex[0].x-P.x)^Vec3f(triangleVertex[2].y-triangleVertex[0].y, triangleVertex[1].y-triangleVertex[0].y, triangleVertex[0].y-P.y);
+
+	// triangleVertex and P has integer value as coordinates
+	// so abs(barycentricWeight[2]) < 1 means barycentricWeight[2] is 0, that means
+	// triangle is degenerate, in this case return something with negative coordinates
+	if (std::abs(barycentricWeight.z)<1) {
+		return Vec3f(-1,1,1);
+	}
+	return Vec3f(1.f-(barycentricWeight.x+barycentricWeight.y)/barycentricWeight.z, barycentricWeight.y/barycentricWeight.z, barycentricWeight.x/barycentricWeight.z); 
+}
+
+void setScreenBoundaries(Vec3f *triangleVertex, Vec2i* bboxMin, Vec2i* bboxMax, const Framebuffer &framebuffer) {
+	bboxMin->u = framebuffer.getWidth()-1;
+	bboxMin->v =  framebuffer.getHeight()-1; 
+	bboxMax->u = 0;
+	bboxMax->v = 0;
+	for (int i=0; i<3; i++) {  
+		bboxMin->x = std::max<int>(0, std::min<int>(bboxMin->x, triangleVertex[i].x));
+		bboxMin->y = std::max<int>(0, std::min<int>(bboxMin->y, triangleVertex[i].y));
+
+		bboxMax->x = std::min<int>(clamp.x, std::max<int>(bboxMax->x, std::ceil(triangleVertex[i].x)));
+		bboxMax->y = std::min<int>(clamp.y, std::max<int>(bboxMax->y, std::ceil(triangleVertex[i].y)));
+	} 
+}
+
+Vec3f calculateCameraVertex(Vec3f& vector) {
+	// Let's transform the original 3D vector into 4D for homogeneous coordinates
+	// projected, scaled, and turn back to 3D
+	Vec3f result = (viewport * projection * modelView).transformPoint(vector);
+
+	return result;
+	
+	// This is the "flat" calculation method for the 3D vectors on a 2D plane without camera projection
+	// scaled to the resolution of the screen or image
+	// Since there is no transformation or rotation of any kind, the camera would be fixed on (0, 0, z)
+	// float x0 = (vector.x + 1.) * (float)WIDTH / 2.;
+	// float y0 = (vector.y + 1.) * (float)HEIGHT / 2.;
+	// float z0 = vector.z * (float)DEPTH;
+	
+	// return Vec3f(x0, y0, z0);
+}
+
+// Signed distance of a homogeneous position to one of the clipping planes, positive on the inner side.
+// The projection sets w = 1 - z/c for a view space depth z, so (w - 1) * c is how far in front of the eye it is
+float clipPlaneDistance(int plane, const Vec4f &position) {
+	switch (plane) {
+	case CLIP_NEAR:
+		return (position.w - 1.f) * camera.z - NEAR_PLANE_DISTANCE;
+	case CLIP_GUARD_LEFT:
+		return position.x + GUARD_BAND * position.w;
+	case CLIP_GUARD_RIGHT:
+		return (screenWidth + GUARD_BAND) * position.w - position.x;
+	case CLIP_GUARD_BOTTOM:
+		return position.y + GUARD_BAND * position.w;
+	default:
+		return (screenHeight + GUARD_BAND) * position.w - position.y;
+	}
+}
+
+// The planes are tested before the division by w, so a vertex behind the eye is classified right too.
+// The margin of a pixel on the screen sides keeps it safe from the snapping of the vertices in the edge function rasterizer
+uint16_t computeClipCode(const Vec4f &position) {
+	uint16_t code = 0;
+	if (position.x < -position.w) code |= CLIP_LEFT;
+	if (position.x > screenWidth * position.w) code |= CLIP_RIGHT;
+	if (position.y < -position.w) code |= CLIP_BOTTOM;
+	if (position.y > screenHeight * position.w) code |= CLIP_TOP;
+	for (int plane = CLIP_NEAR; plane <= CLIP_GUARD_TOP; plane <<= 1) {
+		if (clipPlaneDistance(plane, position) < 0) {
+			code |= plane;
+		}
+	}
+	return code;
+}
+
+void processModelVertices() {
+	// Each vertex is shared by around six faces, so instead of running the whole
+	// viewport * projection * modelView chain per face corner we compose it once
+	// and transform every vertex of the model a single time per frame
+	Mat4f transform = viewport * projection * modelView;
+	int totalVertices = model->getTotalVertices();
+	screenVertices.resize(totalVertices);
+	clipVertices.resize(totalVertices);
+	clipCodes.resize(totalVertices);
+	transform.transformBatch(model->getVertices(), screenVertices.data(), totalVertices, clipVertices.data());
+	for (int i = 0; i < totalVertices; i++) {
+		clipCodes[i] = computeClipCode(clipVertices[i]);
+	}
+}
+
+// A corner of a face while it is being clipped, weights are its barycentric coordinates in the original face
+struct ClipVertex {
+	Vec4f position;
+	Vec3f weights;
+};
+
+// Every plane crossed adds at most one vertex to the polygon
+const int MAX_CLIPPED_VERTICES = 3 + 5;
+
+// Sutherland-Hodgman against the planes set in planes, near first so the others only see positive w.
+// Returns the number of vertices of the convex polygon left in polygon, less than 3 when nothing is
+int clipFace(const FaceCorner *face, uint16_t planes, ClipVertex *polygon) {
+	ClipVertex buffers[2][MAX_CLIPPED_VERTICES];
+	int count = 3;
+	for (int i = 0; i < 3; i++) {
+		buffers[0][i].position = clipVertices[face[i].ivert];
+		buffers[0][i].weights = Vec3f(i == 0, i == 1, i == 2);
+	}
+	int current = 0;
+	for (int plane = CLIP_NEAR; plane <= CLIP_GUARD_TOP && count >= 3; plane <<= 1) {
+		if (!(planes & plane)) {
+			continue;
+		}
+		const ClipVertex *in = buffers[current];
+		ClipVertex *out = buffers[1 - current];
+		int outCount = 0;
+		for (int i = 0; i < count; i++) {
+			const ClipVertex &a = in[i];
+			const ClipVertex &b = in[(i + 1) % count];
+			float distanceA = clipPlaneDistance(plane, a.position);
+			float distanceB = clipPlaneDistance(plane, b.position);
+			if (distanceA >= 0) {
+				out[outCount++] = a;
+			}
+			if ((distanceA >= 0) != (distanceB >= 0)) {
+				// Everything is linear in homogeneous space, the position and the weights move along the edge together
+				float t = distanceA / (distanceA - distanceB);
+				ClipVertex &crossing = out[outCount++];
+				for (int j = 0; j < 4; j++) {
+					crossing.position.raw[j] = a.position.raw[j] + (b.position.raw[j] - a.position.raw[j]) * t;
+				}
+				crossing.weights = a.weights + (b.weights - a.weights) * t;
+			}
+		}
+		count = outCount;
+		current = 1 - current;
+	}
+	for (int i = 0; i < count; i++) {
+		polygon[i] = buffers[current][i];
+	}
+	return count;
+}
+
+// Signed area of the face on the screen, positive when it is counterclockwise, which is the front for the OBJ files.
+// With a corner behind the eye the projected positions mean nothing, so the same sign comes from the
+// determinant of the homogeneous x, y and w, which is the area times the three w
+float faceScreenArea(const FaceCorner *face, bool crossesNearPlane) {
+	if (crossesNearPlane) {
+		const Vec4f &a = clipVertices[face[0].ivert];
+		const Vec4f &b = clipVertices[face[1].ivert];
+		const Vec4f &c = clipVertices[face[2].ivert];
+		return a.x * (b.y * c.w - c.y * b.w) - b.x * (a.y * c.w - c.y * a.w) + c.x * (a.y * b.w - b.y * a.w);
+	}
+	const Vec3f &a = screenVertices[face[0].ivert];
+	const Vec3f &b = screenVertices[face[1].ivert];
+	const Vec3f &c = screenVertices[face[2].ivert];
+	return (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+}
+
+// Everything the rasterizer needs from a face once it has been through the vertex stage,
+// the varyings are whatever the shader wants to carry from vertex() to fragment()
+template <class Shader>
+struct ShadedTriangle {
+	Vec3f vertex[3];
+	Vec2i bboxMin;
+	Vec2i bboxMax;
+	typename Shader::Varyings varyings;
+	// Set on the pieces left by the clipper, which share the varyings of the whole face:
+	// sourceWeights[i] are the barycentric coordinates of vertex i in that face
+	bool clipped;
+	Vec3f sourceWeights[3];
+};
+
+// Pixel counters of the rasterizer, kept in locals by whoever draws a run of triangles
+// and added to the frame stats at once when it is done
+struct RasterCounters {
+	long long tested;
+	long long depthFailed;
+	long long written;
+	long long shaded;
+	// Triangles dropped by the HiZ test over the rectangle they were drawn through, a binned
+	// triangle counts once for every tile it is rejected in
+	long long hizCulledDraws;
+
+	RasterCounters() : tested(0), depthFailed(0), written(0), shaded(0), hizCulledDraws(0) {
+	}
+};
+
+void addRasterCounters(const RasterCounters &counters) {
+	if (pipelineStats != NULL) {
+		pipelineStats->add(FrameStats::PIXELS_TESTED, counters.tested);
+		pipelineStats->add(FrameStats::PIXELS_DEPTH_FAILED, counters.depthFailed);
+		pipelineStats->add(FrameStats::PIXELS_WRITTEN, counters.written);
+		pipelineStats->add(FrameStats::PIXELS_SHADED, counters.shaded);
+	}
+}
+
+void addHiZCulledTriangles(long long triangles) {
+	if (hiZBuffer != NULL) {
+		hiZBuffer->addCulledTriangles(triangles);
+	}
+	if (pipelineStats != NULL) {
+		pipelineStats->add(FrameStats::TRIANGLES_HIZ_CULLED, triangles);
+	}
+}
+
+inline float interpolateDepth(const Vec3f *triangleVertex, const Vec3f &barycentricWeights) {
+	float depth = 0;
+	depth += triangleVertex[0].z * barycentricWeights.x;
+	depth += triangleVertex[1].z * barycentricWeights.y;
+	depth += triangleVertex[2].z * barycentricWeights.z;
+	return depth;
+}
+
+// Weights of the pixel in the face the triangle comes from, which is what the varyings are for
+template <class Shader>
+inline Vec3f faceWeights(const ShadedTriangle<Shader> &triangle, const Vec3f &barycentricWeights) {
+	if (!triangle.clipped) {
+		return barycentricWeights;
+	}
+	return triangle.sourceWeights[0] * barycentricWeights.x + triangle.sourceWeights[1] * barycentricWeights.y + triangle.sourceWeights[2] * barycentricWeights.z;
+}
+
+enum DepthTest {
+	DEPTH_TEST_NEARER,  // in front of what the z buffer holds
+	DEPTH_TEST_EQUAL    // exactly what the z buffer holds, after a depth pre-pass only the visible fragments pass it
+};
+
+// depth points at the pixel P. True when the fragment passed the depth test and the shader kept it,
+// color and intensity are then what the shader returned, still to be multiplied together
+template <class Shader>
+inline bool shadeFragment(const Shader &shader, const ShadedTriangle<Shader> &triangle, Vec3f P, const Vec3f &barycentricWeights, float *depth, PackedColor &color, float &intensity, RasterCounters &counters, DepthTest depthTest=DEPTH_TEST_NEARER) {
+	P.z = interpolateDepth(triangle.vertex, barycentricWeights);
+	counters.tested++;
+	if (depthTest == DEPTH_TEST_EQUAL ? *depth != P.z : *depth >= P.z) {
+		counters.depthFailed++;
+		return false;
+	}
+
+	intensity = 1.f;
+	counters.shaded++;
+	if (shader.fragment(triangle.varyings, faceWeights(triangle, barycentricWeights), P, color, intensity)) {
+		// discarded by the shader, it doesn't hide anything behind it
+		return false;
+	}
+
+	// This is a visible point, update the Z Buffer
+	*depth = P.z;
+	return true;
+}
+
+// One pixel at a time for the scalar paths, the rasterizers get depth and pixel from row pointers after clipping
+template <class Shader>
+inline bool shadePixel(const Shader &shader, const ShadedTriangle<Shader> &triangle, const Vec3f &P, const Vec3f &barycentricWeights, float *depth, PackedColor *pixel, RasterCounters &counters) {
+	PackedColor color;
+	float intensity;
+	if (!shadeFragment(shader, triangle, P, barycentricWeights, depth, color, intensity, counters)) {
+		return false;
+	}
+	modulateColors(&color, &intensity, 1, gammaLut);
+	*pixel = color;
+	counters.written++;
+	return true;
+}
+
+template <class Shader>
+void rasterizeTriangleBarycentric(const Shader &shader, const ShadedTriangle<Shader> &triangle, Vec2i clipMin, Vec2i clipMax, float *zbuffer, Framebuffer &framebuffer, RasterCounters &counters) {
+	// Only the part of the bounding box inside [clipMin, clipMax] is drawn,
+	// this way the same triangle can be split across screen tiles
+	int xMin = std::max(triangle.bboxMin.x, clipMin.x);
+	int yMin = std::max(triangle.bboxMin.y, clipMin.y);
+	int xMax = std::min(triangle.bboxMax.x, clipMax.x);
+	int yMax = std::min(triangle.bboxMax.y, clipMax.y);
+
+	Vec3f P;
+
+	for (P.x = xMin; P.x <= xMax; P.x++) { 
+		for (P.y = yMin; P.y <= yMax; P.y++) {
+			Vec3f barycentricWeights  = getBarycentricVector(triangle.vertex, P); 
+			if (barycentricWeights.x < 0 || barycentricWeights.y < 0 || barycentricWeights.z < 0) {
+				// Barycentric point is out of the triangle's area, so not a valid coordinate
+				continue;
+			}
+			shadePixel(shader, triangle, P, barycentricWeights, zbuffer + int(P.x + P.y * screenWidth), framebuffer.getSpan(P.x, P.y, 1), counters);
+		} 
+	}
+}
+
+// Vertices are snapped to a grid of 1/16 of a pixel before the edge functions are set up,
+// so coverage is decided with exact integers and doesn't depend on float rounding
+const int SUBPIXEL_BITS = 4;
+const int SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+
+// E(x, y) = a*x + b*y + c over subpixel coordinates, positive on the inner side of the edge,
+// zero on the edge itself and negative outside. 64 bits because with the guard band and
+// 16384 pixel frames the products of two coordinates go past 32 bits
+struct EdgeFunction {
+	long long a, b, c;
+	// Change of E from one pixel to the next along x and y
+	long long stepX, stepY;
+	// Top-left rule: a pixel exactly on an edge only belongs to the triangle the edge is a top or left edge of,
+	// so a pixel on an edge shared by two triangles is drawn once. c of the other edges has 1 subtracted,
+	// which makes E >= 0 mean E > 0 for them. bias adds it back for the barycentric weights
+	int bias;
+
+	// At the sample point of pixel (x, y), which is its integer coordinate like in the barycentric rasterizer
+	long long evaluate(int x, int y) const { return stepX * x + stepY * y + c; }
+	float weight(long long e, float inverseArea) const { return (float)(e + bias) * inverseArea; }
+};
+
+bool setupEdgeFunctions(const Vec3f *triangleVertex, EdgeFunction *edges, float *inverseArea) {
+	// Edge i is the one opposite to vertex i so E_i/area is the barycentric weight of vertex i
+	long long x[3], y[3];
+	for (int i = 0; i < 3; i++) {
+		x[i] = (long long)std::floor(triangleVertex[i].x * SUBPIXEL_SCALE + .5f);
+		y[i] = (long long)std::floor(triangleVertex[i].y * SUBPIXEL_SCALE + .5f);
+	}
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		int k = (i + 2) % 3;
+		edges[i].a = y[j] - y[k];
+		edges[i].b = x[k] - x[j];
+		edges[i].c = x[j] * y[k] - x[k] * y[j];
+	}
+	long long area = edges[0].a * x[0] + edges[0].b * y[0] + edges[0].c;
+	if (area == 0) {
+		// degenerate triangle, nothing to draw
+		return false;
+	}
+	for (int i = 0; i < 3; i++) {
+		if (area < 0) {
+			// clockwise triangle, flip the edges so the inside is always positive
+			edges[i].a = -edges[i].a;
+			edges[i].b = -edges[i].b;
+			edges[i].c = -edges[i].c;
+		}
+		// (a, b) points inside and y goes up on the screen: a left edge has the inside on its right,
+		// a top edge is horizontal with the inside below it
+		bool topLeft = edges[i].a > 0 || (edges[i].a == 0 && edges[i].b < 0);
+		edges[i].bias = topLeft ? 0 : 1;
+		edges[i].c -= edges[i].bias;
+		edges[i].stepX = edges[i].a * SUBPIXEL_SCALE;
+		edges[i].stepY = edges[i].b * SUBPIXEL_SCALE;
+	}
+	*inverseArea = 1.f / (float)(area < 0 ? -area : area);
+	return true;
+}
+
+float nearestBlockDepth(const Vec3f *triangleVertex, const EdgeFunction *edges, float inverseArea, int x0, int y0, int x1, int y1) {
+	// Depth is a plane over the screen, so its maximum over the block is on one of the corners.
+	// The small margin covers the rounding of the per pixel interpolation
+	int cornerX[4] = { x0, x1, x0, x1 };
+	int cornerY[4] = { y0, y0, y1, y1 };
+	float nearest = -std::numeric_limits<float>::max();
+	for (int i = 0; i < 4; i++) {
+		float depth = 0;
+		for (int j = 0; j < 3; j++) {
+			depth += triangleVertex[j].z * edges[j].weight(edges[j].evaluate(cornerX[i], cornerY[i]), inverseArea);
+		}
+		nearest = std::max(nearest, depth);
+	}
+	return nearest + std::abs(nearest) * 1e-5f + 1e-5f;
+}
+
+// Weight of edge i at pixel x of row y, rowStart being the weight at the start of the RASTER_BLOCK_SIZE aligned
+// block x is in. Every pass computes it this same way, so the visibility buffer resolve gets the very same
+// weights as the rasterizer whatever tile or clip rectangle the pixel was drawn through
+inline float interpolateWeight(float rowStart, float step, int x) {
+	return rowStart + (float)(x % RASTER_BLOCK_SIZE) * step;
+}
+
+// Walks the pixels of a triangle inside [clipMin, clipMax] by blocks of RASTER_BLOCK_SIZE that are
+// rejected or accepted as a whole against the edges and the HiZ buffer. Covered pixels are handed over
+// 4 at a time, horizontally adjacent: visit(x, y, covered, weights) where covered has a bit per lane inside
+// the triangle and weights[i][lane] is the barycentric weight of vertex i. visit returns true when it
+// wrote a depth, which refreshes the HiZ tile of the block
+template <class Visitor>
+void traverseTriangle(const Vec3f *triangleVertex, Vec2i bboxMin, Vec2i bboxMax, Vec2i clipMin, Vec2i clipMax, RasterCounters &counters, Visitor visit) {
+	EdgeFunction edges[3];
+	float inverseArea;
+	if (!setupEdgeFunctions(triangleVertex, edges, &inverseArea)) {
+		return;
+	}
+	int xMin = std::max(bboxMin.x, clipMin.x);
+	int yMin = std::max(bboxMin.y, clipMin.y);
+	int xMax = std::min(bboxMax.x, clipMax.x);
+	int yMax = std::min(bboxMax.y, clipMax.y);
+	if (xMin > xMax || yMin > yMax) {
+		return;
+	}
+
+	if (hiZBuffer != NULL) {
+		float nearest = std::max(std::max(triangleVertex[0].z, triangleVertex[1].z), triangleVertex[2].z);
+		nearest += std::abs(nearest) * 1e-5f + 1e-5f;
+		if (hiZBuffer->isOccluded(xMin, yMin, xMax, yMax, nearest)) {
+			hiZBuffer->addCulledRectangle((long long)(xMax - xMin + 1) * (yMax - yMin + 1));
+			counters.hizCulledDraws++;
+			return;
+		}
+	}
+
+	// The barycentric weights only need float precision, they are interpolated from the exact values at each block row
+	float weightStepX[3];
+	for (int i = 0; i < 3; i++) {
+		weightStepX[i] = (float)edges[i].stepX * inverseArea;
+	}
+
+	for (int blockY = yMin - yMin % RASTER_BLOCK_SIZE; blockY <= yMax; blockY += RASTER_BLOCK_SIZE) {
+		for (int blockX = xMin - xMin % RASTER_BLOCK_SIZE; blockX <= xMax; blockX += RASTER_BLOCK_SIZE) {
+			int x0 = std::max(blockX, xMin);
+			int y0 = std::max(blockY, yMin);
+			int x1 = std::min(blockX + RASTER_BLOCK_SIZE - 1, xMax);
+			int y1 = std::min(blockY + RASTER_BLOCK_SIZE - 1, yMax);
+
+			// Edge functions are linear, so their extremes over the block are on its corners:
+			// if an edge is negative on all four corners the block is outside the triangle,
+			// if an edge is positive on all four corners the whole block is on its inner side
+			bool blockOutside = false;
+			bool edgeInside[3] = { false, false, false };
+			long long origin[3];
+			for (int i = 0; i < 3 && !blockOutside; i++) {
+				origin[i] = edges[i].evaluate(x0, y0);
+				long long e10 = origin[i] + edges[i].stepX * (x1 - x0);
+				long long e01 = origin[i] + edges[i].stepY * (y1 - y0);
+				long long e11 = e10 + edges[i].stepY * (y1 - y0);
+				long long eMax = std::max(std::max(origin[i], e10), std::max(e01, e11));
+				long long eMin = std::min(std::min(origin[i], e10), std::min(e01, e11));
+				blockOutside = eMax < 0;
+				edgeInside[i] = eMin >= 0;
+			}
+			if (blockOutside) {
+				continue;
+			}
+			bool blockInside = edgeInside[0] && edgeInside[1] && edgeInside[2];
+			// Blocks are aligned with the HiZ tiles, so each block maps to exactly one of them
+			int tileX = blockX / HiZBuffer::TILE_SIZE;
+			int tileY = blockY / HiZBuffer::TILE_SIZE;
+			if (hiZBuffer != NULL && nearestBlockDepth(triangleVertex, edges, inverseArea, x0, y0, x1, y1) <= hiZBuffer->getFarthest(tileX, tileY)) {
+				hiZBuffer->addCulledTile((long long)(x1 - x0 + 1) * (y1 - y0 + 1));
+				continue;
+			}
+			bool blockWritten = false;
+
+			// Coverage only needs the sign of the edges crossing the block, and those stay within
+			// (|stepX| + |stepY|) * RASTER_BLOCK_SIZE of zero inside it, which fits in 32 bits.
+			// The edges the whole block is on the inner side of are left at 0 so they never reject a pixel
+			int rowStart[3], stepX[3], stepY[3];
+			for (int i = 0; i < 3; i++) {
+				rowStart[i] = edgeInside[i] ? 0 : (int)origin[i];
+				stepX[i] = edgeInside[i] ? 0 : (int)edges[i].stepX;
+				stepY[i] = edgeInside[i] ? 0 : (int)edges[i].stepY;
+			}
+#if defined(GEOMETRY_USE_SSE2)
+			// Edge values of 4 horizontally adjacent pixels relative to the first one
+			__m128i laneOffset[3];
+			for (int i = 0; i < 3; i++) {
+				laneOffset[i] = _mm_setr_epi32(0, stepX[i], 2 * stepX[i], 3 * stepX[i]);
+			}
+#endif
+			for (int y = y0; y <= y1; y++) {
+				int e[3] = { rowStart[0], rowStart[1], rowStart[2] };
+				float weightRowStart[3];
+				for (int i = 0; i < 3; i++) {
+					weightRowStart[i] = edges[i].weight(edges[i].evaluate(blockX, y), inverseArea);
+				}
+#if defined(GEOMETRY_USE_SSE2)
+				__m128 laneDx = _mm_add_ps(_mm_set1_ps((float)(x0 - blockX)), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+				for (int x = x0; x <= x1; x += 4) {
+					__m128i e0 = _mm_add_epi32(_mm_set1_epi32(e[0]), laneOffset[0]);
+					__m128i e1 = _mm_add_epi32(_mm_set1_epi32(e[1]), laneOffset[1]);
+					__m128i e2 = _mm_add_epi32(_mm_set1_epi32(e[2]), laneOffset[2]);
+					int covered = (1 << std::min(4, x1 - x + 1)) - 1;
+					if (!blockInside) {
+						// a pixel is outside as soon as one edge is negative, which is the sign bit
+						int outside = _mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(e0, _mm_or_si128(e1, e2))));
+						covered &= ~outside;
+					}
+					if (covered) {
+						// the same rowStart + dx * step as interpolateWeight
+						alignas(16) float w[3][4];
+						for (int i = 0; i < 3; i++) {
+							_mm_store_ps(w[i], _mm_add_ps(_mm_set1_ps(weightRowStart[i]), _mm_mul_ps(laneDx, _mm_set1_ps(weightStepX[i]))));
+						}
+						blockWritten |= visit(x, y, covered, w);
+					}
+					for (int i = 0; i < 3; i++) {
+						e[i] += 4 * stepX[i];
+					}
+					laneDx = _mm_add_ps(laneDx, _mm_set1_ps(4.f));
+				}
+#else
+				for (int x = x0; x <= x1; x += 4) {
+					int covered = 0;
+					float w[3][4];
+					for (int lane = 0; lane < 4 && x + lane <= x1; lane++) {
+						if (blockInside || (e[0] | e[1] | e[2]) >= 0) {
+							covered |= 1 << lane;
+						}
+						for (int i = 0; i < 3; i++) {
+							w[i][lane] = interpolateWeight(weightRowStart[i], weightStepX[i], x + lane);
+							e[i] += stepX[i];
+						}
+					}
+					if (covered) {
+						blockWritten |= visit(x, y, covered, w);
+					}
+				}
+#endif
+				for (int i = 0; i < 3; i++) {
+					rowStart[i] += stepY[i];
+				}
+			}
+			if (blockWritten && hiZBuffer != NULL) {
+				hiZBuffer->update(zBuffer, screenWidth, screenHeight, tileX, tileY);
+			}
+		}
+	}
+}
+
+template <class Shader>
+void rasterizeTriangleEdgeFunctions(const Shader &shader, const ShadedTriangle<Shader> &triangle, Vec2i clipMin, Vec2i clipMax, float *zbuffer, Framebuffer &framebuffer, RasterCounters &counters, DepthTest depthTest=DEPTH_TEST_NEARER) {
+	Vec3f P;
+	traverseTriangle(triangle.vertex, triangle.bboxMin, triangle.bboxMax, clipMin, clipMax, counters, [&](int x, int y, int covered, const float (*w)[4]) {
+		float *depthRow = zbuffer + y * screenWidth;
+		PackedColor *colorRow = framebuffer.getRow(y);
+		P.y = y;
+		alignas(16) PackedColor laneColor[4];
+		alignas(16) float laneIntensity[4] = { 1.f, 1.f, 1.f, 1.f };
+		int shaded = 0;
+		for (int lane = 0; lane < 4; lane++) {
+			if (covered & (1 << lane)) {
+				P.x = x + lane;
+				if (shadeFragment(shader, triangle, P, Vec3f(w[0][lane], w[1][lane], w[2][lane]), depthRow + x + lane, laneColor[lane], laneIntensity[lane], counters, depthTest)) {
+					shaded |= 1 << lane;
+				}
+			}
+		}
+		if (!shaded) {
+			return false;
+		}
+		// The 4 lanes are modulated together, the ones that weren't shaded are simply not written
+		modulateColors(laneColor, laneIntensity, 4, gammaLut);
+		for (int lane = 0; lane < 4; lane++) {
+			if (shaded & (1 << lane)) {
+				colorRow[x + lane] = laneColor[lane];
+				counters.written++;
+			}
+		}
+		return true;
+	});
+}
+
+// Only the depth test, nothing is shaded. For the depth pre-pass and the first pass of the visibility buffer,
+// which also gives ids, a buffer of screenWidth * screenHeight the triangleId is written to wherever the depth is
+template <class Shader>
+void rasterizeTriangleDepth(const ShadedTriangle<Shader> &triangle, Vec2i clipMin, Vec2i clipMax, float *zbuffer, RasterCounters &counters, uint32_t *ids=NULL, uint32_t triangleId=NO_TRIANGLE) {
+	traverseTriangle(triangle.vertex, triangle.bboxMin, triangle.bboxMax, clipMin, clipMax, counters, [&](int x, int y, int covered, const float (*w)[4]) {
+		float *depthRow = zbuffer + y * screenWidth;
+		uint32_t *idRow = ids != NULL ? ids + y * screenWidth : NULL;
+		bool written = false;
+		for (int lane = 0; lane < 4; lane++) {
+			if (covered & (1 << lane)) {
+				float depth = interpolateDepth(triangle.vertex, Vec3f(w[0][lane], w[1][lane], w[2][lane]));
+				counters.tested++;
+				if (depthRow[x + lane] >= depth) {
+					counters.depthFailed++;
+					continue;
+				}
+				depthRow[x + lane] = depth;
+				if (idRow != NULL) {
+					idRow[x + lane] = triangleId;
+				}
+				counters.written++;
+				written = true;
+			}
+		}
+		return written;
+	});
+}
+
+template <class Shader>
+void rasterizeTriangle(const Shader &shader, const ShadedTriangle<Shader> &triangle, Vec2i clipMin, Vec2i clipMax, float *zbuffer, Framebuffer &framebuffer, RasterCounters &counters) {
+	if (rasterizerMode == RASTERIZER_BARYCENTRIC) {
+		rasterizeTriangleBarycentric(shader, triangle, clipMin, clipMax, zbuffer, framebuffer, counters);
+	} else {
+		rasterizeTriangleEdgeFunctions(shader, triangle, clipMin, clipMax, zbuffer, framebuffer, counters);
+	}
+}
+
+// Calls draw(i, clipMin, clipMax, counters) for every triangle i, either serially over the whole screen
+// or binned into screen tiles drawn in parallel when there are several threads. Returns the pixels written.
+// Without countHiZCulled the triangles the HiZ test drops are left out of the stats, for a pass that
+// draws the same triangles again afterwards
+template <class Shader, class DrawTriangle>
+long long drawTriangles(const std::vector<ShadedTriangle<Shader>> &triangles, DrawTriangle draw, bool countHiZCulled=true) {
+	if (renderWorkers->getTotalThreads() <= 1) {
+		RasterCounters counters;
+		for (int i = 0; i < (int)triangles.size(); i++) {
+			draw(i, Vec2i(0, 0), clamp, counters);
+		}
+		addRasterCounters(counters);
+		if (countHiZCulled) {
+			addHiZCulledTriangles(counters.hizCulledDraws);
+		}
+		return counters.written;
+	}
+
+	// Binning: every tile gets the list of triangles whose bounding box touches it, in submission order
+	int tilesX = (screenWidth + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (screenHeight + TILE_SIZE - 1) / TILE_SIZE;
+	std::vector<std::vector<int>> tileBins(tilesX * tilesY);
+	std::vector<int> binnedTiles(triangles.size(), 0);
+	for (int i = 0; i < (int)triangles.size(); i++) {
+		const ShadedTriangle<Shader> &triangle = triangles[i];
+		if (triangle.bboxMin.x > triangle.bboxMax.x || triangle.bboxMin.y > triangle.bboxMax.y) {
+			continue;
+		}
+		binnedTiles[i] = (triangle.bboxMax.x / TILE_SIZE - triangle.bboxMin.x / TILE_SIZE + 1) * (triangle.bboxMax.y / TILE_SIZE - triangle.bboxMin.y / TILE_SIZE + 1);
+		for (int ty = triangle.bboxMin.y / TILE_SIZE; ty <= triangle.bboxMax.y / TILE_SIZE; ty++) {
+			for (int tx = triangle.bboxMin.x / TILE_SIZE; tx <= triangle.bboxMax.x / TILE_SIZE; tx++) {
+				tileBins[tx + ty * tilesX].push_back(i);
+			}
+		}
+	}
+
+	// Every tile owns its own rectangle of the color and depth buffers, so tiles can be
+	// drawn in parallel without locks. Inside a tile triangles keep the serial order,
+	// which makes the output identical to drawing them one after the other
+	std::atomic<long long> written(0);
+	// The triangles the HiZ test dropped in each tile
+	std::vector<std::vector<int>> tileCulled(tilesX * tilesY);
+	renderWorkers->parallelFor(tilesX * tilesY, [&](int tile) {
+		Vec2i tileMin((tile % tilesX) * TILE_SIZE, (tile / tilesX) * TILE_SIZE);
+		Vec2i tileMax(std::min(tileMin.x + TILE_SIZE - 1, clamp.x), std::min(tileMin.y + TILE_SIZE - 1, clamp.y));
+		const std::vector<int> &bin = tileBins[tile];
+		RasterCounters counters;
+		for (size_t i = 0; i < bin.size(); i++) {
+			long long culled = counters.hizCulledDraws;
+			draw(bin[i], tileMin, tileMax, counters);
+			if (countHiZCulled && counters.hizCulledDraws != culled) {
+				tileCulled[tile].push_back(bin[i]);
+			}
+		}
+		addRasterCounters(counters);
+		written += counters.written;
+	});
+
+	// A triangle only counts as culled once it was dropped in every tile it was binned into
+	long long hizCulledTriangles = 0;
+	std::vector<int> culledTiles(triangles.size(), 0);
+	for (size_t tile = 0; tile < tileCulled.size(); tile++) {
+		for (size_t i = 0; i < tileCulled[tile].size(); i++) {
+			int triangle = tileCulled[tile][i];
+			if (++culledTiles[triangle] == binnedTiles[triangle]) {
+				hizCulledTriangles++;
+			}
+		}
+	}
+	if (countHiZCulled) {
+		addHiZCulledTriangles(hizCulledTriangles);
+	}
+	return written;
+}
+
+// Second pass of the visibility buffer: every pixel with a triangle id is shaded once. The barycentric weights
+// are rebuilt from the edge functions of the triangle exactly as the rasterizer had them, so the result is the
+// same as the forward path. The shaders here never discard, one that does would show the background through
+// its discarded pixels instead of what is behind them.
+// Returns the pixels shaded
+template <class Shader>
+long long resolveVisibilityBuffer(const Shader &shader, const std::vector<ShadedTriangle<Shader>> &triangles, Framebuffer &framebuffer) {
+	std::atomic<long long> shadedPixels(0);
+	renderWorkers->parallelFor(screenHeight, [&](int y) {
+		const uint32_t *idRow = triangleIds.data() + y * screenWidth;
+		const float *depthRow = zBuffer + y * screenWidth;
+		PackedColor *colorRow = framebuffer.getRow(y);
+		// Neighbouring pixels mostly belong to the same triangle, its edge functions are only set up when it changes
+		uint32_t currentId = NO_TRIANGLE;
+		EdgeFunction edges[3];
+		float inverseArea = 0.f;
+		float weightStepX[3] = { 0.f, 0.f, 0.f };
+		long long rowShaded = 0;
+
+		// Shaded a span at a time so the colors are modulated together
+		const int SPAN = 64;
+		alignas(16) PackedColor spanColor[SPAN];
+		alignas(16) float spanIntensity[SPAN];
+		int spanX[SPAN];
+		for (int spanStart = 0; spanStart < screenWidth; spanStart += SPAN) {
+			int count = 0;
+			int spanEnd = std::min(spanStart + SPAN, screenWidth);
+			for (int x = spanStart; x < spanEnd; x++) {
+				uint32_t id = idRow[x];
+				if (id == NO_TRIANGLE) {
+					continue;
+				}
+				const ShadedTriangle<Shader> &triangle = triangles[id];
+				if (id != currentId) {
+					currentId = id;
+					setupEdgeFunctions(triangle.vertex, edges, &inverseArea);
+					for (int i = 0; i < 3; i++) {
+						weightStepX[i] = (float)edges[i].stepX * inverseArea;
+					}
+				}
+				int blockX = x - x % RASTER_BLOCK_SIZE;
+				Vec3f barycentricWeights;
+				for (int i = 0; i < 3; i++) {
+					barycentricWeights.raw[i] = interpolateWeight(edges[i].weight(edges[i].evaluate(blockX, y), inverseArea), weightStepX[i], x);
+				}
+				Vec3f P((float)x, (float)y, depthRow[x]);
+				spanIntensity[count] = 1.f;
+				rowShaded++;
+				if (shader.fragment(triangle.varyings, faceWeights(triangle, barycentricWeights), P, spanColor[count], spanIntensity[count])) {
+					continue;
+				}
+				spanX[count++] = x;
+			}
+			modulateColors(spanColor, spanIntensity, count, gammaLut);
+			for (int i = 0; i < count; i++) {
+				colorRow[spanX[i]] = spanColor[i];
+			}
+		}
+		shadedPixels += rowShaded;
+	});
+	if (pipelineStats != NULL) {
+		pipelineStats->add(FrameStats::PIXELS_SHADED, shadedPixels);
+	}
+	return shadedPixels;
+}
+
+// Clips the face against the planes and appends what is left as a fan of triangles sharing its varyings
+template <class Shader>
+void appendClippedTriangles(const ShadedTriangle<Shader> &triangle, const FaceCorner *face, uint16_t planes, const Framebuffer &framebuffer, std::vector<ShadedTriangle<Shader>> &triangles) {
+	ClipVertex polygon[MAX_CLIPPED_VERTICES];
+	int count = clipFace(face, planes, polygon);
+	for (int i = 1; i + 1 < count; i++) {
+		ShadedTriangle<Shader> piece = triangle;
+		piece.clipped = true;
+		const ClipVertex *corners[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+		for (int j = 0; j < 3; j++) {
+			const Vec4f &position = corners[j]->position;
+			piece.vertex[j] = Vec3f(position.x / position.w, position.y / position.w, position.z / position.w);
+			piece.sourceWeights[j] = corners[j]->weights;
+		}
+		setScreenBoundaries(piece.vertex, &piece.bboxMin, &piece.bboxMax, framebuffer);
+		triangles.push_back(piece);
+	}
+}
+
+// Nearest triangles first, so the depth test rejects more of the ones behind before they are shaded.
+// Keyed on the depth of the centroid quantized to 16 bits over the depth range of the frame and sorted
+// with two passes of an 8 bit radix sort, which is stable: triangles with the same key keep their order
+template <class Shader>
+void sortFrontToBack(std::vector<ShadedTriangle<Shader>> &triangles) {
+	size_t count = triangles.size();
+	if (count < 2) {
+		return;
+	}
+	std::vector<float> centroidDepth(count);
+	float nearest = -std::numeric_limits<float>::max();
+	float farthest = std::numeric_limits<float>::max();
+	for (size_t i = 0; i < count; i++) {
+		const Vec3f *vertex = triangles[i].vertex;
+		centroidDepth[i] = (vertex[0].z + vertex[1].z + vertex[2].z) / 3.f;
+		nearest = std::max(nearest, centroidDepth[i]);
+		farthest = std::min(farthest, centroidDepth[i]);
+	}
+	// Bigger depths are nearer, the key grows going away from the eye
+	float scale = nearest > farthest ? 65535.f / (nearest - farthest) : 0.f;
+	std::vector<uint16_t> keys(count);
+	for (size_t i = 0; i < count; i++) {
+		keys[i] = (uint16_t)std::min(65535.f, (nearest - centroidDepth[i]) * scale);
+	}
+
+	std::vector<uint32_t> order(count);
+	std::vector<uint32_t> sorted(count);
+	for (size_t i = 0; i < count; i++) {
+		order[i] = (uint32_t)i;
+	}
+	for (int shift = 0; shift < 16; shift += 8) {
+		size_t offsets[256] = {};
+		for (size_t i = 0; i < count; i++) {
+			offsets[(keys[i] >> shift) & 0xFF]++;
+		}
+		size_t total = 0;
+		for (int bucket = 0; bucket < 256; bucket++) {
+			size_t bucketSize = offsets[bucket];
+			offsets[bucket] = total;
+			total += bucketSize;
+		}
+		for (size_t i = 0; i < count; i++) {
+			sorted[offsets[(keys[order[i]] >> shift) & 0xFF]++] = order[i];
+		}
+		order.swap(sorted);
+	}
+
+	std::vector<ShadedTriangle<Shader>> reordered;
+	reordered.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		reordered.push_back(triangles[order[i]]);
+	}
+	triangles.swap(reordered);
+}
+
+template <class Shader>
+void drawTriangleSurfaces(IShader<Shader> &baseShader, Framebuffer &framebuffer) {
+	// Resolved at compile time, from here on every shader call is on the concrete type
+	Shader &shader = baseShader.derived();
+
+	std::vector<ShadedTriangle<Shader>> triangles;
+	long long frustumCulledTriangles = 0;
+	long long backfaceCulledTriangles = 0;
+	long long culledTriangles = 0;
+	long long clippedTriangles = 0;
+	{
+		StageTimer timer(pipelineStats, FrameStats::STAGE_SETUP);
+		triangles.reserve(model->getTotalFaces());
+		for (int i=0; i < model->getTotalFaces(); i++) {
+			// Primitive assembly: faces outside the frustum or turned away are dropped before the shader sees them
+			const FaceCorner *face = model->getFaceByIndex(i);
+			uint16_t code0 = clipCodes[face[0].ivert];
+			uint16_t code1 = clipCodes[face[1].ivert];
+			uint16_t code2 = clipCodes[face[2].ivert];
+			if (code0 & code1 & code2 & CLIP_OUTSIDE_MASK) {
+				frustumCulledTriangles++;
+				continue;
+			}
+			uint16_t planes = (code0 | code1 | code2) & CLIP_PLANES_MASK;
+			if (backfaceCulling && faceScreenArea(face, (planes & CLIP_NEAR) != 0) <= 0) {
+				backfaceCulledTriangles++;
+				continue;
+			}
+
+			ShadedTriangle<Shader> triangle;
+			triangle.clipped = false;
+			if (!shader.face(i, triangle.varyings)) {
+				culledTriangles++;
+				continue;
+			}
+			for (int j=0; j < Model::VERTICES_PER_FACE; j++) {
+				triangle.vertex[j] = shader.vertex(i, j, triangle.varyings);
+			}
+			if (planes != 0) {
+				clippedTriangles++;
+				appendClippedTriangles(triangle, face, planes, framebuffer, triangles);
+				continue;
+			}
+			setScreenBoundaries(triangle.vertex, &triangle.bboxMin, &triangle.bboxMax, framebuffer);
+			triangles.push_back(triangle);
+		}
+		if (frontToBack) {
+			sortFrontToBack(triangles);
+		}
+	}
+	if (pipelineStats != NULL) {
+		pipelineStats->add(FrameStats::TRIANGLES_SUBMITTED, model->getTotalFaces());
+		pipelineStats->add(FrameStats::TRIANGLES_FRUSTUM_CULLED, frustumCulledTriangles);
+		pipelineStats->add(FrameStats::TRIANGLES_BACKFACE_CULLED, backfaceCulledTriangles);
+		pipelineStats->add(FrameStats::TRIANGLES_CULLED, culledTriangles);
+		pipelineStats->add(FrameStats::TRIANGLES_CLIPPED, clippedTriangles);
+		pipelineStats->add(FrameStats::TRIANGLES_RASTERIZED, (long long)triangles.size());
+	}
+
+	if (!visibilityBuffer && depthPrepass) {
+		{
+			StageTimer timer(pipelineStats, FrameStats::STAGE_PREPASS);
+			drawTriangles(triangles, [&](int i, Vec2i clipMin, Vec2i clipMax, RasterCounters &counters) {
+				rasterizeTriangleDepth(triangles[i], clipMin, clipMax, zBuffer, counters);
+			}, false);
+		}
+		// The z buffer now holds the nearest depth of every pixel, and the same traversal computes
+		// the same depths again, so only the fragments that end up visible are shaded
+		StageTimer timer(pipelineStats, FrameStats::STAGE_RASTER);
+		drawTriangles(triangles, [&](int i, Vec2i clipMin, Vec2i clipMax, RasterCounters &counters) {
+			rasterizeTriangleEdgeFunctions(shader, triangles[i], clipMin, clipMax, zBuffer, framebuffer, counters, DEPTH_TEST_EQUAL);
+		});
+		return;
+	}
+	if (!visibilityBuffer) {
+		StageTimer timer(pipelineStats, FrameStats::STAGE_RASTER);
+		drawTriangles(triangles, [&](int i, Vec2i clipMin, Vec2i clipMax, RasterCounters &counters) {
+			rasterizeTriangle(shader, triangles[i], clipMin, clipMax, zBuffer, framebuffer, counters);
+		});
+		return;
+	}
+
+	// Ids only mean something for the triangles of this draw, the pixels left from earlier ones are kept as they are
+	triangleIds.assign((size_t)screenWidth * screenHeight, NO_TRIANGLE);
+	long long idsWritten;
+	{
+		StageTimer timer(pipelineStats, FrameStats::STAGE_RASTER);
+		idsWritten = drawTriangles(triangles, [&](int i, Vec2i clipMin, Vec2i clipMax, RasterCounters &counters) {
+			rasterizeTriangleDepth(triangles[i], clipMin, clipMax, zBuffer, counters, triangleIds.data(), (uint32_t)i);
+		});
+	}
+	StageTimer timer(pipelineStats, FrameStats::STAGE_SHADE);
+	long long shadedPixels = resolveVisibilityBuffer(shader, triangles, framebuffer);
+	if (pipelineStats != NULL) {
+		// Every depth write of the first pass would have been a fragment() call of the forward path
+		pipelineStats->add(FrameStats::PIXELS_SHADING_SAVED, idsWritten - shadedPixels);
+	}
+}
+
+void drawScreenTriangle(const Vec3f *triangleVertex, PackedColor color, Framebuffer &framebuffer) {
+	// Without a model there is nothing for face() and vertex() to do, the triangle is set up directly
+	FlatShader shader(NULL, NULL, color, lightDirection);
+	ShadedTriangle<FlatShader> triangle;
+	for (int i = 0; i < 3; i++) {
+		triangle.vertex[i] = triangleVertex[i];
+	}
+	triangle.varyings.intensity = 1.f;
+	triangle.clipped = false;
+	setScreenBoundaries(triangle.vertex, &triangle.bboxMin, &triangle.bboxMax, framebuffer);
+	RasterCounters counters;
+	rasterizeTriangle(shader, triangle, Vec2i(0, 0), clamp, zBuffer, framebuffer, counters);
+	addRasterCounters(counters);
+	addHiZCulledTriangles(counters.hizCulledDraws);
+}
+
+void drawWireframeObjModel(Framebuffer &framebuffer) {
+	float* wireframeZBuffer = new float[model->getTotalFaces() * 3];
+	for (int i=0; i < model->getTotalFaces(); i++) {
+		const FaceCorner *face = model->getFaceByIndex(i);
+		for (int j=0; j < Model::VERTICES_PER_FACE; j++) {
+			const FaceCorner &faceVertexOrigin = face[j];
+			Vec3f r0 = screenVertices[faceVertexOrigin.ivert];
+
+			const FaceCorner &faceVertexEnd = face[(j+1)%3];
+			Vec3f r1 = screenVertices[faceVertexEnd.ivert];
+
+			// TODO try at creating a z buffer for the wireframe, needs refinement
+			// float indexZ = 0.;
+			// indexZ += (r0.z + r1.z) / 2;
+			// if (wireframeZBuffer[int(i + j * 3)] >= indexZ) {
+			// 	continue;
+			// }
+			// wireframeZBuffer[int(i + j * 3)] = indexZ;
+			
+			drawLine(r0.x, r0.y, r1.x, r1.y, framebuffer, PackedColor(Util::COLOR_WHITE));
+		}
+	}
+	delete[] wireframeZBuffer;
+}
+
+void drawObjModel(Framebuffer &framebuffer, Texture* diffuseTexture, ShadingMode shadingMode, bool enableWireframe) {
+	{
+		StageTimer timer(pipelineStats, FrameStats::STAGE_VERTEX);
+		processModelVertices();
+	}
+
+	// Each case instantiates the whole raster pipeline for its shader
+	switch (shadingMode) {
+	case SHADING_TEXTURE: {
+		TextureShader shader(model, screenVertices.data(), diffuseTexture, lightDirection);
+		drawTriangleSurfaces(shader, framebuffer);
+		break;
+	}
+	case SHADING_GOURAUD: {
+		GouraudShader shader(model, screenVertices.data(), lightDirection);
+		drawTriangleSurfaces(shader, framebuffer);
+		break;
+	}
+	case SHADING_GRADIENT: {
+		GradientShader shader(model, screenVertices.data(), screenWidth, screenHeight);
+		drawTriangleSurfaces(shader, framebuffer);
+		break;
+	}
+	case SHADING_FLAT: {
+		FlatShader shader(model, screenVertices.data(), PackedColor(Util::COLOR_WHITE), lightDirection);
+		drawTriangleSurfaces(shader, framebuffer);
+		break;
+	}
+	case SHADING_RANDOM: {
+		RandomColorShader shader(model, screenVertices.data());
+		drawTriangleSurfaces(shader, framebuffer);
+		break;
+	}
+	}
+	
+	if (enableWireframe) {
+		drawWireframeObjModel(framebuffer);
+	} 
+}
+
+void clearFrame(Framebuffer &framebuffer) {
+	StageTimer timer(pipelineStats, FrameStats::STAGE_CLEAR);
+	framebuffer.clear(PackedColor(0, 0, 0, 255));
+	// Everything starts infinitely far away, the depths after the viewport transform are negative
+	std::fill(zBuffer, zBuffer + screenWidth * screenHeight, -std::numeric_limits<float>::max());
+	if (hiZBuffer != NULL) {
+		hiZBuffer->clear(-std::numeric_limits<float>::max());
+	}
+}
+
+FrameStats finishFrameStats(int frame) {
+	// Pixels written at least once are the ones whose depth moved from the background
+	long long covered = 0;
+	for (int i = 0; i < screenWidth * screenHeight; i++) {
+		covered += zBuffer[i] != -std::numeric_limits<float>::max();
+	}
+	pipelineStats->add(FrameStats::PIXELS_COVERED, covered);
+	FrameStats stats = pipelineStats->snapshot(frame);
+	pipelineStats->reset();
+	return stats;
+}
@@ -0,0 +1,121 @@
+#ifndef __RENDERER_H__
+#define __RENDERER_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+#include "threadpool.h"
+#include "hizbuffer.h"
+#include "texture.h"
+#include "framebuffer.h"
+#include "color.h"
+#include "pipelinestats.h"
+
+// The raster pipeline: the state of the frame being drawn lives in the globals below,
+// set them up and call clearFrame() and drawObjModel() once per frame
+
+const int DEPTH = 255;
+// Triangles are clipped against planes this many pixels past the screen sides only when they cross them,
+// anything closer is left to the scissoring of the rasterizer. Keeps the integer edge functions small
+const int GUARD_BAND = 1024;
+// Distance in front of the eye of the near plane, in model units
+const float NEAR_PLANE_DISTANCE = .01f;
+// Pixels of triangleIds no triangle of the draw covers
+const uint32_t NO_TRIANGLE = 0xFFFFFFFF;
+
+enum ClipCode {
+	CLIP_LEFT = 1 << 0,          // more than a pixel past a side of the screen
+	CLIP_RIGHT = 1 << 1,
+	CLIP_BOTTOM = 1 << 2,
+	CLIP_TOP = 1 << 3,
+	CLIP_NEAR = 1 << 4,          // behind the near plane, from here on the planes the clipper cuts against
+	CLIP_GUARD_LEFT = 1 << 5,    // past the guard band
+	CLIP_GUARD_RIGHT = 1 << 6,
+	CLIP_GUARD_BOTTOM = 1 << 7,
+	CLIP_GUARD_TOP = 1 << 8,
+	CLIP_OUTSIDE_MASK = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR,
+	CLIP_PLANES_MASK = CLIP_NEAR | CLIP_GUARD_LEFT | CLIP_GUARD_RIGHT | CLIP_GUARD_BOTTOM | CLIP_GUARD_TOP
+};
+
+enum RasterizerMode {
+	RASTERIZER_BARYCENTRIC,    // barycentric coordinates solved for every pixel of the bounding box
+	RASTERIZER_EDGE_FUNCTION   // incremental integer edge functions evaluated by blocks
+};
+
+enum ShadingMode {
+	SHADING_TEXTURE,   // diffuse texture with flat lighting
+	SHADING_GOURAUD,   // white with lighting interpolated from the vertex normals
+	SHADING_GRADIENT,  // unlit, colored by the screen position
+	SHADING_FLAT,      // white with flat lighting
+	SHADING_RANDOM     // unlit, a random color per face
+};
+
+// Size of zBuffer and of the framebuffers drawn into, changed with setResolution()
+extern int screenWidth;
+extern int screenHeight;
+extern float *zBuffer;
+extern Vec2i clamp;
+
+extern Model *model;
+// Mipmapped copy of the diffuse map, NULL when it could not be read
+extern Texture *diffuseTexture;
+// Threads used by the tiled rasterizer, with a single thread triangles are drawn serially
+extern ThreadPool *renderWorkers;
+extern RasterizerMode rasterizerMode;
+// Applied to every shaded pixel when set with --gamma, NULL leaves the colors linear
+extern GammaLut *gammaLut;
+// Farthest depth per 8x8 tile of zBuffer, used to drop hidden triangles and blocks early. NULL disables it
+extern HiZBuffer *hiZBuffer;
+// Timers and counters of the frame being drawn, NULL unless stats were asked for
+extern PipelineStats *pipelineStats;
+// Drops the triangles facing away from the eye in every shading mode, --no-backface-culling turns it off
+extern bool backfaceCulling;
+// Draws depth and triangle ids first and shades every visible pixel once afterwards, set with --visibility-buffer.
+// Always goes through the edge function rasterizer
+extern bool visibilityBuffer;
+// Triangles drawn nearest first instead of in the order of the model, set with --front-to-back
+extern bool frontToBack;
+// Fills the z buffer with a depth only pass before shading with an equal depth test, set with --depth-prepass.
+// Always goes through the edge function rasterizer, and does nothing with the visibility buffer which is depth first already
+extern bool depthPrepass;
+
+extern Vec3f eye;
+extern Vec3f center;
+extern Vec3f up;
+extern Vec3f camera;
+extern Vec3f lightDirection;
+
+extern Mat4f viewport;
+extern Mat4f modelView;
+extern Mat4f projection;
+
+// Screen space position of every model vertex for the current frame, indexed by vertex id
+extern std::vector<Vec3f> screenVertices;
+// The same positions before the division by w, the clipper works on these
+extern std::vector<Vec4f> clipVertices;
+// ClipCode bits of every vertex, the planes it is on the wrong side of
+extern std::vector<uint16_t> clipCodes;
+// Index in the triangles of the current draw of the one visible at each pixel, NO_TRIANGLE where it drew nothing.
+// Only filled in visibility buffer mode
+extern std::vector<uint32_t> triangleIds;
+
+// Resizes the z buffer, the HiZ buffer when there is one and the viewport
+void setResolution(int width, int height);
+// texture, gouraud, gradient, flat or random. False leaves mode as it was
+bool parseShadingMode(const std::string &name, ShadingMode &mode);
+
+std::vector<Vec2f> drawLine(int x0, int y0, int x1, int y1, Framebuffer &framebuffer, PackedColor color);
+Vec3f getBarycentricVector(const Vec3f *triangleVertex, Vec3f P);
+void setScreenBoundaries(Vec3f *triangleVertex, Vec2i* bboxMin, Vec2i* bboxMax, const Framebuffer &framebuffer);
+void processModelVertices();
+// A single screen space triangle of one color through the same rasterizer and z buffer as the models
+void drawScreenTriangle(const Vec3f *triangleVertex, PackedColor color, Framebuffer &framebuffer);
+void drawObjModel(Framebuffer &framebuffer, Texture* diffuseTexture, ShadingMode shadingMode, bool enableWireframe);
+// Everything back to the background before a frame is drawn
+void clearFrame(Framebuffer &framebuffer);
+// Takes the numbers of the frame just drawn and starts counting the next one from zero
+FrameStats finishFrameStats(int frame);
+
+#endif //__RENDERER_H__
@@ -0,0 +1,214 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include "tgaimage.h"
+#include "gl_util.h"
+#include "renderserver.h"
+
+// Jobs can't ask for more than this on either side
+const int MAX_JOB_SIZE = 16384;
+
+RenderJob::RenderJob() : eye(1, 1, 3), center(0, 0, 0), up(0, 1, 0), width(800), height(800), shadingMode(SHADING_TEXTURE) {
+	texturePath = "obj/head_diffuse.tga";
+}
+
+static bool parseVector(const std::string &value, Vec3f &vector) {
+	return sscanf(value.c_str(), "%f,%f,%f", &vector.x, &vector.y, &vector.z) == 3
+		&& std::isfinite(vector.x) && std::isfinite(vector.y) && std::isfinite(vector.z);
+}
+
+// The model view matrix needs a view direction, and an up vector that isn't along it
+static bool isCameraValid(const Vec3f &eye, const Vec3f &center, const Vec3f &up) {
+	Vec3f direction = center - eye;
+	float length = direction.norm();
+	float upLength = up.norm();
+	if (!(length > 1e-6f) || !(upLength > 1e-6f)) {
+		return false;
+	}
+	return (direction ^ up).norm() > 1e-4f * length * upLength;
+}
+
+bool RenderJob::parse(const std::string &line, std::string &error) {
+	std::istringstream fields(line);
+	std::string field;
+	while (fields >> field) {
+		size_t separator = field.find('=');
+		if (separator == std::string::npos) {
+			error = "expected key=value instead of " + field;
+			return false;
+		}
+		std::string key = field.substr(0, separator);
+		std::string value = field.substr(separator + 1);
+		bool valid = true;
+		if (key == "model") {
+			modelPath = value;
+		} else if (key == "texture") {
+			texturePath = value == "none" ? "" : value;
+		} else if (key == "output") {
+			outputPath = value;
+		} else if (key == "eye") {
+			valid = parseVector(value, eye);
+		} else if (key == "center") {
+			valid = parseVector(value, center);
+		} else if (key == "up") {
+			valid = parseVector(value, up);
+		} else if (key == "size") {
+			valid = sscanf(value.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0 && width <= MAX_JOB_SIZE && height <= MAX_JOB_SIZE;
+		} else if (key == "shader") {
+			valid = parseShadingMode(value, shadingMode);
+		} else {
+			error = "unknown key " + key;
+			return false;
+		}
+		if (!valid) {
+			error = "invalid " + key + " " + value;
+			return false;
+		}
+	}
+	if (outputPath.empty()) {
+		error = "no output";
+		return false;
+	}
+	if (!isCameraValid(eye, center, up)) {
+		error = "invalid camera, eye is on center or up is along the view direction";
+		return false;
+	}
+	return true;
+}
+
+// Quoted and escaped for the JSON report
+static std::string jsonString(const std::string &value) {
+	std::string quoted = "\"";
+	for (size_t i = 0; i < value.size(); i++) {
+		char c = value[i];
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		} else if ((unsigned char)c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			quoted += escaped;
+		} else {
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+static double millisecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+RenderServer::RenderServer(bool useMeshCache, size_t cacheBudget, bool optimizeMeshes) : assets(cacheBudget, useMeshCache, optimizeMeshes), framebuffer(NULL) {
+}
+
+RenderServer::~RenderServer() {
+	delete framebuffer;
+	model = NULL;
+	diffuseTexture = NULL;
+}
+
+Framebuffer* RenderServer::getFramebuffer(int width, int height) {
+	if (framebuffer == NULL || framebuffer->getWidth() != width || framebuffer->getHeight() != height) {
+		delete framebuffer;
+		framebuffer = new Framebuffer(width, height);
+	}
+	return framebuffer;
+}
+
+bool RenderServer::render(int jobIndex, const RenderJob &job, std::string &reportLine) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::string error;
+
+	bool modelCached = false;
+	bool textureCached = false;
+	// Held until the job is done so the cache can't evict them under it
+	std::shared_ptr<Model> jobModel = assets.getModel(job.modelPath, &modelCached);
+	std::shared_ptr<Texture> jobTexture;
+	if (!jobModel) {
+		error = "can't load the model " + job.modelPath;
+	} else if (!job.texturePath.empty()) {
+		jobTexture = assets.getTexture(job.texturePath, &textureCached);
+		if (!jobTexture) {
+			error = "can't load the texture " + job.texturePath;
+		}
+	}
+	std::chrono::steady_clock::time_point loaded = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point rendered = loaded;
+	std::chrono::steady_clock::time_point encoded = loaded;
+	std::chrono::steady_clock::time_point written = loaded;
+	size_t bytes = 0;
+
+	if (error.empty()) {
+		if (job.width != screenWidth || job.height != screenHeight) {
+			setResolution(job.width, job.height);
+		}
+		Framebuffer *jobFramebuffer = getFramebuffer(job.width, job.height);
+		model = jobModel.get();
+		diffuseTexture = jobTexture.get();
+		eye = job.eye;
+		center = job.center;
+		up = job.up;
+		modelView = Util::generateModelView(eye, center, up);
+		clearFrame(*jobFramebuffer);
+		drawObjModel(*jobFramebuffer, diffuseTexture, job.shadingMode, false);
+		rendered = std::chrono::steady_clock::now();
+
+		TGAImage image(job.width, job.height, TGAImage::RGB);
+		jobFramebuffer->writeToImage(image);
+		image.flip_vertically(); // Origin is at the left bottom corner of the image
+		std::vector<unsigned char> file;
+		// the frame is drawn, so the render workers are free to encode it
+		image.encode(TGAImage::format_from_filename(job.outputPath.c_str(), TGAImage::TGA_FILE), file, renderWorkers);
+		bytes = file.size();
+		encoded = std::chrono::steady_clock::now();
+		if (!TGAImage::write_buffer(job.outputPath.c_str(), file)) {
+			error = "can't write " + job.outputPath;
+		}
+		written = std::chrono::steady_clock::now();
+		model = NULL;
+		diffuseTexture = NULL;
+	}
+
+	std::ostringstream report;
+	report << "{\"job\": " << jobIndex << ", \"output\": " << jsonString(job.outputPath) << ", \"ok\": " << (error.empty() ? "true" : "false");
+	if (!error.empty()) {
+		report << ", \"error\": " << jsonString(error);
+	}
+	report << ", \"model_cached\": " << (modelCached ? "true" : "false") << ", \"texture_cached\": " << (textureCached ? "true" : "false")
+		<< ", \"load_ms\": " << millisecondsBetween(start, loaded) << ", \"render_ms\": " << millisecondsBetween(loaded, rendered)
+		<< ", \"encode_ms\": " << millisecondsBetween(rendered, encoded) << ", \"write_ms\": " << millisecondsBetween(encoded, written)
+		<< ", \"latency_ms\": " << millisecondsBetween(start, written) << ", \"bytes\": " << bytes
+		<< ", \"asset_cache\": " << assets.getStats().toJson() << "}";
+	reportLine = report.str();
+	return error.empty();
+}
+
+int RenderServer::run(std::istream &input, std::ostream &report, const RenderJob &defaults) {
+	int failedJobs = 0;
+	int jobIndex = 0;
+	std::string line;
+	while (std::getline(input, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r') {
+			line.erase(line.size() - 1);
+		}
+		size_t first = line.find_first_not_of(" \t");
+		if (first == std::string::npos || line[first] == '#') {
+			continue;
+		}
+		RenderJob job = defaults;
+		std::string error;
+		std::string reportLine;
+		if (!job.parse(line, error)) {
+			reportLine = "{\"job\": " + std::to_string(jobIndex) + ", \"ok\": false, \"error\": " + jsonString(error) + "}";
+			failedJobs++;
+		} else if (!render(jobIndex, job, reportLine)) {
+			failedJobs++;
+		}
+		// flushed right away, the runner waits for it before sending the next job
+		report << reportLine << std::endl;
+		jobIndex++;
+	}
+	return failedJobs;
+}
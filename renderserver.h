@@ -0,0 +1,57 @@
+#ifndef __RENDERSERVER_H__
+#define __RENDERSERVER_H__
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include "geometry.h"
+#include "model.h"
+#include "texture.h"
+#include "framebuffer.h"
+#include "assetcache.h"
+#include "renderer.h"
+
+// Everything a job can set, the fields it leaves out keep the values of the server defaults
+struct RenderJob {
+	std::string modelPath;
+	// Empty renders without a texture
+	std::string texturePath;
+	std::string outputPath;
+	Vec3f eye;
+	Vec3f center;
+	Vec3f up;
+	int width;
+	int height;
+	ShadingMode shadingMode;
+
+	RenderJob();
+	// One job per line as space separated key=value pairs, for example
+	//   model=obj/head.obj texture=obj/head_diffuse.tga eye=1,1,3 center=0,0,0 up=0,1,0 size=800x800 shader=gouraud output=head.qoi
+	// texture=none drops the texture. False with a message in error when something can't be read
+	bool parse(const std::string &line, std::string &error);
+};
+
+// Headless mode for job runners: jobs are read one per line and rendered back to back by the same process,
+// so the models and textures loaded by one job stay in the asset cache for the next ones, and the
+// framebuffer is kept while the jobs ask for the same size. Every job gets a JSON line on the report stream with its latency
+// split by step and the asset cache counters
+class RenderServer {
+private:
+	AssetCache assets;
+	// Only the last size is kept, a server seeing many sizes would otherwise hold one buffer for each
+	Framebuffer *framebuffer;
+
+	Framebuffer* getFramebuffer(int width, int height);
+	// False when the job failed, reportLine is its JSON line either way
+	bool render(int jobIndex, const RenderJob &job, std::string &reportLine);
+public:
+	// Loaded models and textures are evicted once they take more than cacheBudget bytes.
+	// With optimizeMeshes the models are loaded through optimizeMesh()
+	RenderServer(bool useMeshCache, size_t cacheBudget, bool optimizeMeshes=false);
+	~RenderServer();
+	// Runs every job of input until it ends, blank lines and lines starting with # are skipped.
+	// Returns the number of jobs that failed
+	int run(std::istream &input, std::ostream &report, const RenderJob &defaults);
+};
+
+#endif //__RENDERSERVER_H__
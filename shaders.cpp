@@ -1,23 +1,24 @@
-#include <iostream>
-#include <string>
-#include <fstream>
-#include <sstream>
-#include <iostream>
-#include <vector>
 #include "shaders.h"
 
 
-    
-Vec4f GouraudShader::vertex(int iface, int nthvert) {
-    // varying_intensity[nthvert] = std::max(0.f, model->normal(iface, nthvert)*light_dir); // get diffuse lighting intensity
-    // Vec4f gl_Vertex = std::embed<4>(model->vert(iface, nthvert)); // read the vertex from .obj file
-    // return this->viewport * this->projection * this->modelView * gl_Vertex; // transform it to screen coordinates
+TextureShader::TextureShader(Model *model, const Vec3f *screenVertices, Texture *diffuseTexture, const Vec3f &lightDirection) : IShader(model, screenVertices) {
+    this->diffuseTexture = diffuseTexture;
+    this->lightDirection = lightDirection;
+}
+
+GouraudShader::GouraudShader(Model *model, const Vec3f *screenVertices, const Vec3f &lightDirection) : IShader(model, screenVertices) {
+    this->lightDirection = lightDirection;
+}
+
+GradientShader::GradientShader(Model *model, const Vec3f *screenVertices, int width, int height) : IShader(model, screenVertices) {
+    this->width = width;
+    this->height = height;
+}
+
+FlatShader::FlatShader(Model *model, const Vec3f *screenVertices, PackedColor color, const Vec3f &lightDirection) : IShader(model, screenVertices) {
+    this->color = color;
+    this->lightDirection = lightDirection;
+}
 
-    return Vec4f();
+RandomColorShader::RandomColorShader(Model *model, const Vec3f *screenVertices) : IShader(model, screenVertices) {
 }
-    
-bool GouraudShader::fragment(Vec3f bar, TGAColor &color) {
-    float intensity = varying_intensity*bar;   // interpolate intensity for the current pixel
-    color = TGAColor(255, 255, 255, 255) * intensity; // well duh
-    return false;                              // no, we do not discard this pixel
-}
\ No newline at end of file
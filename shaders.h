@@ -1,38 +1,243 @@
 #ifndef __SHADERS_H__
 #define __SHADERS_H__
 
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
 #include "geometry.h"
 #include "tgaimage.h"
+#include "model.h"
+#include "gl_util.h"
+#include "texture.h"
+#include "color.h"
 
+// Shaders are plugged into the rasterizer as template parameters instead of through virtual calls,
+// every shader derives from IShader<itself> (CRTP) so rasterize<Shader> sees the concrete type
+// and vertex()/fragment() get inlined into the pixel loop.
+//
+// A shader provides:
+//   struct Varyings                                     per triangle data written by vertex(), read by fragment()
+//   bool face(int iface, Varyings &varyings)            once per face, false drops the whole face
+//   Vec3f vertex(int iface, int nthvert, Varyings &)    returns the screen position of the corner
+//   bool fragment(const Varyings &, const Vec3f &bar, const Vec3f &P, PackedColor &color, float &intensity) const
+//                                                       true discards the pixel, like in tinyrenderer.
+//                                                       intensity comes in as 1, the rasterizer multiplies
+//                                                       color by it for several pixels at once
+template <class Derived>
 class IShader {
 protected:
-	Matrix* viewport;
-	Matrix* projection;
-	Matrix* modelView;
-	
+	Model *model;
+	// Screen space position of every model vertex, computed once per frame before the shaders run
+	const Vec3f *screenVertices;
+
+	IShader(Model *model, const Vec3f *screenVertices) {
+		this->model = model;
+		this->screenVertices = screenVertices;
+	}
+
+	const Vec3f& screenVertex(int iface, int nthvert) const {
+		return screenVertices[model->getFaceByIndex(iface)[nthvert].ivert];
+	}
+
+	// Flat lighting of a face from its object space vertices
+	float faceIntensity(int iface, const Vec3f &lightDirection) const {
+		const FaceCorner *face = model->getFaceByIndex(iface);
+		const Vec3f &v0 = model->getVertexByIndex(face[0].ivert);
+		const Vec3f &v1 = model->getVertexByIndex(face[1].ivert);
+		const Vec3f &v2 = model->getVertexByIndex(face[2].ivert);
+		Vec3f normalVector = (v2 - v0) ^ (v1 - v0);
+		normalVector.normalize();
+		return normalVector * lightDirection;
+	}
+
+public:
+	Derived& derived() { return *static_cast<Derived*>(this); }
+	const Derived& derived() const { return *static_cast<const Derived*>(this); }
+};
+
+// Diffuse texture modulated by the flat intensity of the face, faces turned away from the light are dropped
+class TextureShader : public IShader<TextureShader> {
+private:
+	Texture *diffuseTexture;
+	Vec3f lightDirection;
+
+public:
+	struct Varyings {
+		Vec3f uv[3];
+		float intensity;
+		float lod;
+	};
+
+	TextureShader(Model *model, const Vec3f *screenVertices, Texture *diffuseTexture, const Vec3f &lightDirection);
+
+	bool face(int iface, Varyings &varyings) {
+		varyings.intensity = faceIntensity(iface, lightDirection);
+		return varyings.intensity > 0;
+	}
+
+	Vec3f vertex(int iface, int nthvert, Varyings &varyings) {
+		const FaceCorner &corner = model->getFaceByIndex(iface)[nthvert];
+		if (model->getTotalTextureVertices() > 0 && corner.iuv != NO_INDEX) {
+			varyings.uv[nthvert] = model->getTextureVertexByIndex(corner.iuv);
+		} else {
+			// without texture coordinates the whole face samples the same texel
+			varyings.uv[nthvert] = Vec3f(0, 0, 0);
+		}
+		if (nthvert == 2 && diffuseTexture != nullptr) {
+			varyings.lod = textureLod(iface, varyings);
+		}
+		return screenVertex(iface, nthvert);
+	}
+
+	bool fragment(const Varyings &varyings, const Vec3f &bar, const Vec3f &P, PackedColor &color, float &intensity) const {
+		intensity = varyings.intensity;
+		if (diffuseTexture == nullptr) {
+			color = PackedColor(255, 255, 255, 255);
+			return false;
+		}
+		// We use the barycentric weights of P across the screen triangle
+		// and interpolate it through the texture triangle
+		Vec3f interpolatedPoint = varyings.uv[0] * bar.x + varyings.uv[1] * bar.y + varyings.uv[2] * bar.z;
+		color = diffuseTexture->sample(interpolatedPoint.x, interpolatedPoint.y, varyings.lod);
+		return false;
+	}
+
+private:
+	// The uvs are interpolated linearly in screen space, so their derivatives over any 2x2 quad
+	// of pixels are the same for the whole triangle and the lod can be picked once per face
+	float textureLod(int iface, const Varyings &varyings) const {
+		const Vec3f &s0 = screenVertex(iface, 0);
+		const Vec3f &s1 = screenVertex(iface, 1);
+		const Vec3f &s2 = screenVertex(iface, 2);
+		float area = (s1.x - s0.x) * (s2.y - s0.y) - (s2.x - s0.x) * (s1.y - s0.y);
+		if (std::abs(area) < 1e-6f) {
+			return 0.f;
+		}
+		Vec3f du = varyings.uv[1] - varyings.uv[0];
+		Vec3f dv = varyings.uv[2] - varyings.uv[0];
+		float dudx = (du.x * (s2.y - s0.y) - dv.x * (s1.y - s0.y)) / area;
+		float dvdx = (du.y * (s2.y - s0.y) - dv.y * (s1.y - s0.y)) / area;
+		float dudy = (dv.x * (s1.x - s0.x) - du.x * (s2.x - s0.x)) / area;
+		float dvdy = (dv.y * (s1.x - s0.x) - du.y * (s2.x - s0.x)) / area;
+		return diffuseTexture->computeLod(dudx, dvdx, dudy, dvdy);
+	}
+};
+
+// White lit per vertex from the model normals, the intensity is interpolated across the face
+class GouraudShader : public IShader<GouraudShader> {
+private:
+	Vec3f lightDirection;
+
+public:
+	struct Varyings {
+		Vec3f intensity;
+	};
+
+	GouraudShader(Model *model, const Vec3f *screenVertices, const Vec3f &lightDirection);
+
+	bool face(int iface, Varyings &varyings) {
+		return true;
+	}
+
+	Vec3f vertex(int iface, int nthvert, Varyings &varyings) {
+		const FaceCorner &corner = model->getFaceByIndex(iface)[nthvert];
+		if (corner.inorm != NO_INDEX) {
+			// the normals point out of the surface, the light travels towards it
+			Vec3f normal = model->getNormalByIndex(corner.inorm);
+			varyings.intensity[nthvert] = std::max(0.f, normal * (lightDirection * -1.f));
+		} else {
+			varyings.intensity[nthvert] = std::max(0.f, faceIntensity(iface, lightDirection));
+		}
+		return screenVertex(iface, nthvert);
+	}
+
+	bool fragment(const Varyings &varyings, const Vec3f &bar, const Vec3f &P, PackedColor &color, float &intensity) const {
+		color = PackedColor(255, 255, 255, 255);
+		intensity = varyings.intensity * bar;
+		return false;
+	}
+};
+
+// Every face is drawn, colored by the position of the pixel on the screen
+class GradientShader : public IShader<GradientShader> {
+private:
+	int width;
+	int height;
+
 public:
-	IShader(Matrix& viewport, Matrix& projection, Matrix& modelView) {
-		this->viewport = &viewport;
-		this->projection = &projection;
-		this->modelView = &modelView;
+	struct Varyings {
+	};
+
+	GradientShader(Model *model, const Vec3f *screenVertices, int width, int height);
+
+	bool face(int iface, Varyings &varyings) {
+		return true;
 	}
-	virtual ~IShader() {
-		// needs testing for children classes
+
+	Vec3f vertex(int iface, int nthvert, Varyings &varyings) {
+		return screenVertex(iface, nthvert);
+	}
+
+	bool fragment(const Varyings &varyings, const Vec3f &bar, const Vec3f &P, PackedColor &color, float &intensity) const {
+		Vec3f pixel = P;
+		Vec3f normalizedPixel = Util::normalizeVector(&pixel, width, height, width + height, 1);
+		color = PackedColor(255 * normalizedPixel.x, 255 * normalizedPixel.y, 0, 255);
+		return false;
 	}
-	virtual Vec4f vertex(int iface, int nthvert) = 0;
-	virtual bool fragment(Vec3f bar, TGAColor &color) = 0;
 };
 
-class GouraudShader : public IShader {
+// A single color with flat lighting, faces turned away from the light are dropped
+class FlatShader : public IShader<FlatShader> {
 private:
-	Vec3f varying_intensity; // written by vertex shader, read by fragment shader
+	PackedColor color;
+	Vec3f lightDirection;
+
+public:
+	struct Varyings {
+		float intensity;
+	};
+
+	FlatShader(Model *model, const Vec3f *screenVertices, PackedColor color, const Vec3f &lightDirection);
+
+	bool face(int iface, Varyings &varyings) {
+		varyings.intensity = faceIntensity(iface, lightDirection);
+		return varyings.intensity > 0;
+	}
 
+	Vec3f vertex(int iface, int nthvert, Varyings &varyings) {
+		return screenVertex(iface, nthvert);
+	}
+
+	bool fragment(const Varyings &varyings, const Vec3f &bar, const Vec3f &P, PackedColor &color, float &intensity) const {
+		color = this->color;
+		intensity = varyings.intensity;
+		return false;
+	}
+};
+
+// Every face gets a random color, handy to see how the mesh is triangulated
+class RandomColorShader : public IShader<RandomColorShader> {
 public:
-	GouraudShader(Matrix& viewport, Matrix& projection, Matrix& modelView) : IShader(viewport, projection, modelView) {
-		
+	struct Varyings {
+		PackedColor color;
+	};
+
+	RandomColorShader(Model *model, const Vec3f *screenVertices);
+
+	bool face(int iface, Varyings &varyings) {
+		// Picked in submission order, so the colors don't depend on how the triangles are scheduled
+		varyings.color = PackedColor(rand() % 255, rand() % 255, rand() % 255, 255);
+		return true;
+	}
+
+	Vec3f vertex(int iface, int nthvert, Varyings &varyings) {
+		return screenVertex(iface, nthvert);
+	}
+
+	bool fragment(const Varyings &varyings, const Vec3f &bar, const Vec3f &P, PackedColor &color, float &intensity) const {
+		color = varyings.color;
+		return false;
 	}
-	Vec4f vertex(int iface, int nthvert) override;
-	bool fragment(Vec3f bar, TGAColor &color) override;
 };
 
 #endif //__SHADERS_H__
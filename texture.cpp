@@ -0,0 +1,64 @@
+#include "texture.h"
+
+Texture::Texture(TGAImage &image) {
+	int width = std::max(1, image.get_width());
+	int height = std::max(1, image.get_height());
+
+	// Level 0 is read through TGAImage::get once
+	std::vector<uint32_t> rows(width * height);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			rows[x + y * width] = PackedColor(image.get(x, y)).val;
+		}
+	}
+
+	while (true) {
+		levels.push_back(MipLevel());
+		MipLevel &level = levels.back();
+		level.width = width;
+		level.height = height;
+		storeLevel(level, rows);
+		if (width == 1 && height == 1) {
+			break;
+		}
+
+		// Next level is a 2x2 box filter of this one, odd sizes repeat the last row or column
+		int nextWidth = std::max(1, width / 2);
+		int nextHeight = std::max(1, height / 2);
+		std::vector<uint32_t> nextRows(nextWidth * nextHeight);
+		for (int y = 0; y < nextHeight; y++) {
+			int y0 = std::min(2 * y, height - 1);
+			int y1 = std::min(2 * y + 1, height - 1);
+			for (int x = 0; x < nextWidth; x++) {
+				int x0 = std::min(2 * x, width - 1);
+				int x1 = std::min(2 * x + 1, width - 1);
+				const unsigned char *texel[4] = {
+					(const unsigned char*)&rows[x0 + y0 * width],
+					(const unsigned char*)&rows[x1 + y0 * width],
+					(const unsigned char*)&rows[x0 + y1 * width],
+					(const unsigned char*)&rows[x1 + y1 * width]
+				};
+				PackedColor average;
+				for (int channel = 0; channel < 4; channel++) {
+					average.raw[channel] = (texel[0][channel] + texel[1][channel] + texel[2][channel] + texel[3][channel] + 2) / 4;
+				}
+				nextRows[x + y * nextWidth] = average.val;
+			}
+		}
+		rows.swap(nextRows);
+		width = nextWidth;
+		height = nextHeight;
+	}
+}
+
+void Texture::storeLevel(MipLevel &level, const std::vector<uint32_t> &rows) {
+	// Padded up to whole tiles, the padding is never sampled because coordinates wrap on the real size
+	level.tilesX = (level.width + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (level.height + TILE_SIZE - 1) / TILE_SIZE;
+	level.texels.assign(level.tilesX * tilesY * TILE_SIZE * TILE_SIZE, 0);
+	for (int y = 0; y < level.height; y++) {
+		for (int x = 0; x < level.width; x++) {
+			level.texels[texelOffset(level, x, y)] = rows[x + y * level.width];
+		}
+	}
+}
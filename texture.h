@@ -0,0 +1,104 @@
+#ifndef __TEXTURE_H__
+#define __TEXTURE_H__
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "tgaimage.h"
+#include "color.h"
+
+// Read only copy of an image made for sampling: a full mip chain where every level is stored
+// as 8x8 tiles in Z-order (Morton) instead of rows, so the texels of a 2x2 bilinear footprint
+// and of neighbouring pixels are almost always in the same cache line.
+// Texels are PackedColor values and coordinates wrap around
+class Texture {
+private:
+	struct MipLevel {
+		int width;
+		int height;
+		int tilesX;
+		std::vector<uint32_t> texels;
+	};
+	std::vector<MipLevel> levels;
+
+	static void storeLevel(MipLevel &level, const std::vector<uint32_t> &rows);
+
+	static uint32_t texelOffset(const MipLevel &level, int x, int y) {
+		// bits of x and y interleaved inside the tile, tiles are in row order
+		static const uint32_t spread[TILE_SIZE] = { 0, 1, 4, 5, 16, 17, 20, 21 };
+		uint32_t tile = (uint32_t)((x / TILE_SIZE) + (y / TILE_SIZE) * level.tilesX);
+		return (tile * TILE_SIZE * TILE_SIZE) | spread[x % TILE_SIZE] | (spread[y % TILE_SIZE] << 1);
+	}
+
+	static int wrap(int x, int size) {
+		if ((unsigned)x < (unsigned)size) {
+			return x;
+		}
+		x %= size;
+		return x < 0 ? x + size : x;
+	}
+
+	// Blends every channel of a and b at once, f goes from 0 (a) to 256 (b)
+	static uint32_t lerpTexel(uint32_t a, uint32_t b, uint32_t f) {
+		uint32_t rb = (((a & 0x00ff00ff) * (256 - f) + (b & 0x00ff00ff) * f) >> 8) & 0x00ff00ff;
+		uint32_t ga = (((a >> 8) & 0x00ff00ff) * (256 - f) + ((b >> 8) & 0x00ff00ff) * f) & 0xff00ff00;
+		return rb | ga;
+	}
+
+public:
+	static const int TILE_SIZE = 8;
+
+	Texture(TGAImage &image);
+	int getWidth() const { return levels[0].width; }
+	int getHeight() const { return levels[0].height; }
+	int getTotalLevels() const { return (int)levels.size(); }
+	// Bytes of every level, padding included
+	size_t getMemoryUsage() const {
+		size_t bytes = sizeof(Texture);
+		for (size_t i = 0; i < levels.size(); i++) {
+			bytes += sizeof(MipLevel) + levels[i].texels.size() * sizeof(uint32_t);
+		}
+		return bytes;
+	}
+
+	// Level of detail for a footprint given the derivatives of u and v (0..1 over the image)
+	// along the screen x and y axes: log2 of the texels covered by one pixel
+	float computeLod(float dudx, float dvdx, float dudy, float dvdy) const {
+		float w = (float)levels[0].width;
+		float h = (float)levels[0].height;
+		float footprintX = (dudx * w) * (dudx * w) + (dvdx * h) * (dvdx * h);
+		float footprintY = (dudy * w) * (dudy * w) + (dvdy * h) * (dvdy * h);
+		float footprint = footprintX > footprintY ? footprintX : footprintY;
+		// log2 of the squared length, halved
+		return footprint > 0 ? .5f * std::log2(footprint) : 0.f;
+	}
+
+	// Bilinear filtered sample from the mip level closest to lod
+	PackedColor sample(float u, float v, float lod) const {
+		int levelIndex = 0;
+		if (lod > 0) {
+			levelIndex = std::min((int)(lod + .5f), (int)levels.size() - 1);
+		}
+		const MipLevel &level = levels[levelIndex];
+
+		// texel centers are at half integers
+		float x = u * level.width - .5f;
+		float y = v * level.height - .5f;
+		float xFloor = std::floor(x);
+		float yFloor = std::floor(y);
+		uint32_t fx = (uint32_t)((x - xFloor) * 256.f);
+		uint32_t fy = (uint32_t)((y - yFloor) * 256.f);
+		int x0 = wrap((int)xFloor, level.width);
+		int y0 = wrap((int)yFloor, level.height);
+		int x1 = x0 + 1 < level.width ? x0 + 1 : 0;
+		int y1 = y0 + 1 < level.height ? y0 + 1 : 0;
+
+		const uint32_t *texels = level.texels.data();
+		uint32_t top = lerpTexel(texels[texelOffset(level, x0, y0)], texels[texelOffset(level, x1, y0)], fx);
+		uint32_t bottom = lerpTexel(texels[texelOffset(level, x0, y1)], texels[texelOffset(level, x1, y1)], fx);
+		return PackedColor(lerpTexel(top, bottom, fy));
+	}
+};
+
+#endif //__TEXTURE_H__
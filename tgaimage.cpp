@@ -1,8 +1,15 @@
 #include <iostream>
 #include <fstream>
 #include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string>
 #include <time.h>
 #include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include "geometry.h"
+#include "mappedfile.h"
 #include "tgaimage.h"
 
 TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0) {
@@ -43,48 +50,57 @@ TGAImage & TGAImage::operator =(const TGAImage &img) {
 bool TGAImage::read_tga_file(const char *filename) {
 	if (data) delete [] data;
 	data = NULL;
-	std::ifstream in;
-	in.open (filename, std::ios::binary);
-	if (!in.is_open()) {
+	// The whole file is mapped once and decoded straight from memory
+	MappedFile file;
+	if (!file.open(filename)) {
 		std::cerr << "can't open file " << filename << "\n";
-		in.close();
 		return false;
 	}
+	const unsigned char *contents = (const unsigned char *)file.getData();
+	size_t size = file.getSize();
 	TGA_Header header;
-	in.read((char *)&header, sizeof(header));
-	if (!in.good()) {
-		in.close();
+	if (size<sizeof(header)) {
 		std::cerr << "an error occured while reading the header\n";
 		return false;
 	}
+	memcpy(&header, contents, sizeof(header));
 	width   = header.width;
 	height  = header.height;
 	bytespp = header.bitsperpixel>>3;
 	if (width<=0 || height<=0 || (bytespp!=GRAYSCALE && bytespp!=RGB && bytespp!=RGBA)) {
-		in.close();
 		std::cerr << "bad bpp (or width/height) value\n";
 		return false;
 	}
-	unsigned long nbytes = bytespp*width*height;
-	data = new unsigned char[nbytes];
-	if (3==header.datatypecode || 2==header.datatypecode) {
-		in.read((char *)data, nbytes);
-		if (!in.good()) {
-			in.close();
-			std::cerr << "an error occured while reading the data\n";
-			return false;
-		}
-	} else if (10==header.datatypecode||11==header.datatypecode) {
-		if (!load_rle_data(in)) {
-			in.close();
-			std::cerr << "an error occured while reading the data\n";
-			return false;
-		}
-	} else {
-		in.close();
+	if (3!=header.datatypecode && 2!=header.datatypecode && 10!=header.datatypecode && 11!=header.datatypecode) {
 		std::cerr << "unknown file format " << (int)header.datatypecode << "\n";
 		return false;
 	}
+	// pixels start after the image id and the color map, if the file has one
+	size_t offset = sizeof(header) + (unsigned char)header.idlength;
+	if (header.colormaptype) {
+		offset += (size_t)(unsigned short)header.colormaplength * (((unsigned char)header.colormapdepth+7)>>3);
+	}
+	if (offset>size) {
+		std::cerr << "an error occured while reading the header\n";
+		return false;
+	}
+	// Sizes in size_t, 32767x32767 RGBA overflows an int. The file must hold enough data for the pixels
+	// before anything is allocated, and a run packet of 1+bytespp bytes covers at most 128 of them
+	size_t pixels = (size_t)width*height;
+	size_t nbytes = pixels*bytespp;
+	bool rle = 10==header.datatypecode || 11==header.datatypecode;
+	size_t minbytes = rle ? (pixels+127)/128*(1+bytespp) : nbytes;
+	if (size-offset<minbytes) {
+		std::cerr << "an error occured while reading the data\n";
+		return false;
+	}
+	data = new unsigned char[nbytes];
+	if (!rle) {
+		memcpy(data, contents+offset, nbytes);
+	} else if (!decode_rle_data(contents+offset, size-offset)) {
+		std::cerr << "an error occured while reading the data\n";
+		return false;
+	}
 	if (!(header.imagedescriptor & 0x20)) {
 		flip_vertically();
 	}
@@ -92,70 +108,85 @@ bool TGAImage::read_tga_file(const char *filename) {
 		flip_horizontally();
 	}
 	std::cerr << width << "x" << height << "/" << bytespp*8 << "\n";
-	in.close();
 	return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream &in) {
-	unsigned long pixelcount = width*height;
-	unsigned long currentpixel = 0;
-	unsigned long currentbyte  = 0;
-	TGAColor colorbuffer;
-	do {
-		unsigned char chunkheader = 0;
-		chunkheader = in.get();
-		if (!in.good()) {
+// Writes count copies of pixel to dst with stores as wide as the pixel size allows
+static inline void fill_rle_run(unsigned char *dst, const unsigned char *pixel, int bytespp, unsigned long count) {
+	if (1==bytespp) {
+		memset(dst, pixel[0], count);
+	} else if (4==bytespp) {
+		uint32_t value;
+		memcpy(&value, pixel, 4);
+		for (unsigned long i=0; i<count; i++) {
+			memcpy(dst+i*4, &value, 4);
+		}
+	} else if (count<16) {
+		// 3 bytes per pixel from here on, short runs are not worth building the pattern
+		for (unsigned long i=0; i<count; i++) {
+			memcpy(dst+i*3, pixel, 3);
+		}
+	} else {
+		// 48 bytes hold a whole number of 3 byte pixels and of 16 byte blocks
+		unsigned char pattern[48];
+		memcpy(pattern, pixel, 3);
+		memcpy(pattern+3, pattern, 3);
+		memcpy(pattern+6, pattern, 6);
+		memcpy(pattern+12, pattern, 12);
+		memcpy(pattern+24, pattern, 24);
+		unsigned long nbytes = count*3;
+		unsigned long i = 0;
+		for (; i+48<=nbytes; i+=48) {
+			memcpy(dst+i, pattern, 48);
+		}
+		memcpy(dst+i, pattern, nbytes-i);
+	}
+}
+
+bool TGAImage::decode_rle_data(const unsigned char *src, size_t size) {
+	size_t pixelcount = (size_t)width*height;
+	size_t currentpixel = 0;
+	size_t pos = 0;
+	while (currentpixel<pixelcount) {
+		if (pos>=size) {
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
-		if (chunkheader<128) {
-			chunkheader++;
-			for (int i=0; i<chunkheader; i++) {
-				in.read((char *)colorbuffer.raw, bytespp);
-				if (!in.good()) {
-					std::cerr << "an error occured while reading the header\n";
-					return false;
-				}
-				for (int t=0; t<bytespp; t++)
-					data[currentbyte++] = colorbuffer.raw[t];
-				currentpixel++;
-				if (currentpixel>pixelcount) {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
-			}
+		unsigned char chunkheader = src[pos++];
+		bool raw = chunkheader<128;
+		unsigned long count = raw ? chunkheader+1 : chunkheader-127;
+		if (currentpixel+count>pixelcount) {
+			std::cerr << "Too many pixels read\n";
+			return false;
+		}
+		// a raw chunk carries all its pixels, a run only one
+		size_t chunkbytes = (raw ? count : 1)*bytespp;
+		if (size-pos<chunkbytes) {
+			std::cerr << "an error occured while reading the header\n";
+			return false;
+		}
+		unsigned char *dst = data+currentpixel*bytespp;
+		if (raw) {
+			memcpy(dst, src+pos, chunkbytes);
 		} else {
-			chunkheader -= 127;
-			in.read((char *)colorbuffer.raw, bytespp);
-			if (!in.good()) {
-				std::cerr << "an error occured while reading the header\n";
-				return false;
-			}
-			for (int i=0; i<chunkheader; i++) {
-				for (int t=0; t<bytespp; t++)
-					data[currentbyte++] = colorbuffer.raw[t];
-				currentpixel++;
-				if (currentpixel>pixelcount) {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
-			}
+			fill_rle_run(dst, src+pos, bytespp, count);
 		}
-	} while (currentpixel < pixelcount);
+		pos += chunkbytes;
+		currentpixel += count;
+	}
 	return true;
 }
 
-bool TGAImage::write_tga_file(const char *filename, bool rle) {
+bool TGAImage::write_tga_file(const char *filename, bool rle, ThreadPool *workers) {
+	std::vector<unsigned char> file;
+	encode_tga(file, rle, workers);
+	return write_buffer(filename, file);
+}
+
+void TGAImage::encode_tga(std::vector<unsigned char> &out, bool rle, ThreadPool *workers) const {
 	unsigned char developer_area_ref[4] = {0, 0, 0, 0};
 	unsigned char extension_area_ref[4] = {0, 0, 0, 0};
 	unsigned char footer[18] = {'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
-	std::ofstream out;
-	out.open (filename, std::ios::binary);
-	if (!out.is_open()) {
-		std::cerr << "can't open file " << filename << "\n";
-		out.close();
-		return false;
-	}
 	TGA_Header header;
 	memset((void *)&header, 0, sizeof(header));
 	header.bitsperpixel = bytespp<<3;
@@ -163,41 +194,205 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	header.height = height;
 	header.datatypecode = (bytespp==GRAYSCALE?(rle?11:3):(rle?10:2));
 	header.imagedescriptor = 0x20; // top-left origin
-	out.write((char *)&header, sizeof(header));
-	if (!out.good()) {
-		out.close();
-		std::cerr << "can't dump the tga file\n";
-		return false;
-	}
+	out.insert(out.end(), (unsigned char *)&header, (unsigned char *)&header+sizeof(header));
 	if (!rle) {
-		out.write((char *)data, width*height*bytespp);
-		if (!out.good()) {
-			std::cerr << "can't unload raw data\n";
-			out.close();
-			return false;
+		out.insert(out.end(), data, data+width*height*bytespp);
+	} else {
+		encode_rle_data(out, workers);
+	}
+	out.insert(out.end(), developer_area_ref, developer_area_ref+sizeof(developer_area_ref));
+	out.insert(out.end(), extension_area_ref, extension_area_ref+sizeof(extension_area_ref));
+	out.insert(out.end(), footer, footer+sizeof(footer));
+}
+
+// The other formats store the channels as r, g, b(, a) where TGA has b, g, r(, a).
+// Writes channels bytes (3 or 4) per pixel to dst, grayscale is spread and a missing alpha is opaque
+static void copy_swizzled(const unsigned char *src, int bytespp, unsigned char *dst, int channels, unsigned long npixels) {
+	if (bytespp==TGAImage::GRAYSCALE) {
+		for (unsigned long p=0; p<npixels; p++, dst+=channels) {
+			dst[0] = dst[1] = dst[2] = src[p];
+			if (channels==4) dst[3] = 255;
+		}
+	} else if (channels==3) {
+		for (unsigned long p=0; p<npixels; p++, src+=bytespp, dst+=3) {
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
 		}
 	} else {
-		if (!unload_rle_data(out)) {
-			out.close();
-			std::cerr << "can't unload rle data\n";
-			return false;
+		for (unsigned long p=0; p<npixels; p++, src+=bytespp, dst+=4) {
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+			dst[3] = bytespp==TGAImage::RGBA ? src[3] : 255;
 		}
 	}
-	out.write((char *)developer_area_ref, sizeof(developer_area_ref));
-	if (!out.good()) {
-		std::cerr << "can't dump the tga file\n";
-		out.close();
-		return false;
+}
+
+static inline unsigned char *put_uint32_be(unsigned char *dst, uint32_t value) {
+	dst[0] = (unsigned char)(value>>24);
+	dst[1] = (unsigned char)(value>>16);
+	dst[2] = (unsigned char)(value>>8);
+	dst[3] = (unsigned char)value;
+	return dst+4;
+}
+
+// Quite OK Image format, https://qoiformat.org/qoi-specification.pdf
+void TGAImage::encode_qoi(std::vector<unsigned char> &out) const {
+	const unsigned char QOI_OP_INDEX = 0x00, QOI_OP_DIFF = 0x40, QOI_OP_LUMA = 0x80, QOI_OP_RUN = 0xc0;
+	const unsigned char QOI_OP_RGB = 0xfe, QOI_OP_RGBA = 0xff;
+	const unsigned char end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+	int channels = bytespp==RGBA ? 4 : 3;
+	unsigned long npixels = width*height;
+	// sized for the worst case, a full RGBA op for every pixel, and cut down at the end
+	size_t start = out.size();
+	out.resize(start + 14 + npixels*5 + sizeof(end_marker));
+	unsigned char *dst = out.data()+start;
+
+	memcpy(dst, "qoif", 4);
+	dst = put_uint32_be(dst+4, width);
+	dst = put_uint32_be(dst, height);
+	*dst++ = (unsigned char)channels;
+	*dst++ = 0; // sRGB with linear alpha
+
+	// pixels are compared and hashed as r, g, b, a packed in a uint32
+	uint32_t index[64];
+	memset(index, 0, sizeof(index));
+	uint32_t previous = 0xff000000;
+	int run = 0;
+	const unsigned char *src = data;
+	for (unsigned long p=0; p<npixels; p++, src+=bytespp) {
+		unsigned char r, g, b, a = 255;
+		if (bytespp==GRAYSCALE) {
+			r = g = b = src[0];
+		} else {
+			r = src[2]; g = src[1]; b = src[0];
+			if (bytespp==RGBA) a = src[3];
+		}
+		uint32_t px = r | (uint32_t)g<<8 | (uint32_t)b<<16 | (uint32_t)a<<24;
+		if (px==previous) {
+			run++;
+			if (run==62 || p==npixels-1) {
+				*dst++ = QOI_OP_RUN | (run-1);
+				run = 0;
+			}
+			continue;
+		}
+		if (run>0) {
+			*dst++ = QOI_OP_RUN | (run-1);
+			run = 0;
+		}
+		int hash = (r*3 + g*5 + b*7 + a*11) % 64;
+		if (index[hash]==px) {
+			*dst++ = QOI_OP_INDEX | hash;
+		} else {
+			index[hash] = px;
+			if (a==(previous>>24)) {
+				signed char vr = (signed char)(r-(previous&0xff));
+				signed char vg = (signed char)(g-((previous>>8)&0xff));
+				signed char vb = (signed char)(b-((previous>>16)&0xff));
+				signed char vg_r = (signed char)(vr-vg);
+				signed char vg_b = (signed char)(vb-vg);
+				if (vr>-3 && vr<2 && vg>-3 && vg<2 && vb>-3 && vb<2) {
+					*dst++ = QOI_OP_DIFF | (vr+2)<<4 | (vg+2)<<2 | (vb+2);
+				} else if (vg_r>-9 && vg_r<8 && vg>-33 && vg<32 && vg_b>-9 && vg_b<8) {
+					*dst++ = QOI_OP_LUMA | (vg+32);
+					*dst++ = (vg_r+8)<<4 | (vg_b+8);
+				} else {
+					dst[0] = QOI_OP_RGB; dst[1] = r; dst[2] = g; dst[3] = b;
+					dst += 4;
+				}
+			} else {
+				dst[0] = QOI_OP_RGBA; dst[1] = r; dst[2] = g; dst[3] = b; dst[4] = a;
+				dst += 5;
+			}
+		}
+		previous = px;
 	}
-	out.write((char *)extension_area_ref, sizeof(extension_area_ref));
-	if (!out.good()) {
-		std::cerr << "can't dump the tga file\n";
+	memcpy(dst, end_marker, sizeof(end_marker));
+	dst += sizeof(end_marker);
+	out.resize(dst-out.data());
+}
+
+// Binary PPM (P6), always 3 channels
+void TGAImage::encode_ppm(std::vector<unsigned char> &out) const {
+	char header[64];
+	int header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+	unsigned long npixels = width*height;
+	out.insert(out.end(), header, header+header_size);
+	size_t start = out.size();
+	out.resize(start + npixels*3);
+	copy_swizzled(data, bytespp, out.data()+start, 3, npixels);
+}
+
+// PAM (P7), keeps the channels of the image
+void TGAImage::encode_pam(std::vector<unsigned char> &out) const {
+	const char *tuple_type = bytespp==GRAYSCALE ? "GRAYSCALE" : (bytespp==RGBA ? "RGB_ALPHA" : "RGB");
+	char header[128];
+	int header_size = snprintf(header, sizeof(header), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n", width, height, bytespp, tuple_type);
+	unsigned long npixels = width*height;
+	out.insert(out.end(), header, header+header_size);
+	if (bytespp==GRAYSCALE) {
+		out.insert(out.end(), data, data+npixels);
+		return;
+	}
+	size_t start = out.size();
+	out.resize(start + npixels*bytespp);
+	copy_swizzled(data, bytespp, out.data()+start, bytespp, npixels);
+}
+
+TGAImage::FileFormat TGAImage::format_from_filename(const char *filename, FileFormat fallback) {
+	const char *dot = strrchr(filename, '.');
+	if (dot==NULL) {
+		return fallback;
+	}
+	std::string extension(dot+1);
+	for (size_t i=0; i<extension.size(); i++) {
+		extension[i] = (char)tolower((unsigned char)extension[i]);
+	}
+	if (extension=="tga") return TGA_FILE;
+	if (extension=="qoi") return QOI_FILE;
+	if (extension=="ppm") return PPM_FILE;
+	if (extension=="pam") return PAM_FILE;
+	return fallback;
+}
+
+const char *TGAImage::format_extension(FileFormat format) {
+	switch (format) {
+	case QOI_FILE: return "qoi";
+	case PPM_FILE: return "ppm";
+	case PAM_FILE: return "pam";
+	default: return "tga";
+	}
+}
+
+void TGAImage::encode(FileFormat format, std::vector<unsigned char> &out, ThreadPool *workers) const {
+	switch (format) {
+	case QOI_FILE: encode_qoi(out); break;
+	case PPM_FILE: encode_ppm(out); break;
+	case PAM_FILE: encode_pam(out); break;
+	default: encode_tga(out, true, workers); break;
+	}
+}
+
+bool TGAImage::write_file(const char *filename, FileFormat format, ThreadPool *workers) {
+	std::vector<unsigned char> file;
+	encode(format, file, workers);
+	return write_buffer(filename, file);
+}
+
+// Every writer encodes the whole file in memory first, it goes to disk with a single write
+bool TGAImage::write_buffer(const char *filename, const std::vector<unsigned char> &buffer) {
+	std::ofstream out;
+	out.open (filename, std::ios::binary);
+	if (!out.is_open()) {
+		std::cerr << "can't open file " << filename << "\n";
 		out.close();
 		return false;
 	}
-	out.write((char *)footer, sizeof(footer));
+	out.write((const char *)buffer.data(), buffer.size());
 	if (!out.good()) {
-		std::cerr << "can't dump the tga file\n";
+		std::cerr << "can't dump the file " << filename << "\n";
 		out.close();
 		return false;
 	}
@@ -205,47 +400,106 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out) {
-	const unsigned char max_chunk_length = 128;
-	unsigned long npixels = width*height;
+// Pixel p and the one right after it are compared with one or two loads for the usual pixel sizes
+static inline bool rle_same_pixel(const unsigned char *p, int bytespp) {
+	switch (bytespp) {
+	case 1:
+		return p[0] == p[1];
+	case 3: {
+		uint16_t a, b;
+		memcpy(&a, p, 2);
+		memcpy(&b, p + 3, 2);
+		return a == b && p[2] == p[5];
+	}
+	case 4: {
+		uint32_t a, b;
+		memcpy(&a, p, 4);
+		memcpy(&b, p + 4, 4);
+		return a == b;
+	}
+	default:
+		return memcmp(p, p + bytespp, bytespp) == 0;
+	}
+}
+
+// How many of the first max_pairs pixels of p are equal to the pixel right after them.
+// Pixel k equals pixel k+1 for every k of a range exactly when every byte of the range equals the
+// byte bytespp further, so the bytes can be compared 16 at a time whatever the pixel size is
+static unsigned long rle_run_pairs(const unsigned char *p, int bytespp, unsigned long max_pairs) {
+	unsigned long nbytes = max_pairs*bytespp;
+	unsigned long i = 0;
+#if defined(GEOMETRY_USE_SSE2)
+	for (; i+16 <= nbytes; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(p+i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(p+i+bytespp));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) {
+			break;
+		}
+	}
+#endif
+	while (i<nbytes && p[i]==p[i+bytespp]) {
+		i++;
+	}
+	return i/bytespp;
+}
+
+// Same chunks the original encoder produced: a run packet as soon as two pixels are equal, otherwise
+// a raw packet up to the first pixel that starts a run, both at most 128 pixels long
+static void encode_rle_band(const unsigned char *data, unsigned long npixels, int bytespp, std::vector<unsigned char> &out) {
+	const unsigned long max_chunk_length = 128;
+	out.reserve(npixels*bytespp + npixels/max_chunk_length + 1);
 	unsigned long curpix = 0;
 	while (curpix<npixels) {
-		unsigned long chunkstart = curpix*bytespp;
-		unsigned long curbyte = curpix*bytespp;
-		unsigned char run_length = 1;
-		bool raw = true;
-		while (curpix+run_length<npixels && run_length<max_chunk_length) {
-			bool succ_eq = true;
-			for (int t=0; succ_eq && t<bytespp; t++) {
-				succ_eq = (data[curbyte+t]==data[curbyte+t+bytespp]);
-			}
-			curbyte += bytespp;
-			if (1==run_length) {
-				raw = !succ_eq;
-			}
-			if (raw && succ_eq) {
-				run_length--;
-				break;
+		const unsigned char *chunk = data + curpix*bytespp;
+		unsigned long max_pairs = std::min(npixels-curpix-1, max_chunk_length-1);
+		unsigned long run_length = 1 + rle_run_pairs(chunk, bytespp, max_pairs);
+		if (run_length>1) {
+			out.push_back((unsigned char)(run_length+127));
+			out.insert(out.end(), chunk, chunk+bytespp);
+		} else {
+			run_length = 1;
+			while (run_length<max_pairs && !rle_same_pixel(chunk+run_length*bytespp, bytespp)) {
+				run_length++;
 			}
-			if (!raw && !succ_eq) {
-				break;
+			if (run_length==max_pairs) {
+				// no run ahead, the last pixel belongs to the raw chunk too
+				run_length = max_pairs+1;
 			}
-			run_length++;
+			out.push_back((unsigned char)(run_length-1));
+			out.insert(out.end(), chunk, chunk+run_length*bytespp);
 		}
 		curpix += run_length;
-		out.put(raw?run_length-1:run_length+127);
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
-		}
-		out.write((char *)(data+chunkstart), (raw?run_length*bytespp:bytespp));
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
+	}
+}
+
+// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
+void TGAImage::encode_rle_data(std::vector<unsigned char> &out, ThreadPool *workers) const {
+	// Packets never cross a band, so bands of scanlines are encoded on their own in parallel
+	// and appended in order. The band size is fixed so the file doesn't depend on the thread count
+	const int band_rows = RLE_BAND_ROWS;
+	int nbands = (height+band_rows-1)/band_rows;
+	std::vector<std::vector<unsigned char> > bands(nbands);
+	auto encode_band = [&](int band) {
+		int first_row = band*band_rows;
+		int rows = std::min(band_rows, height-first_row);
+		encode_rle_band(data+(size_t)first_row*width*bytespp, (unsigned long)rows*width, bytespp, bands[band]);
+	};
+	if (workers) {
+		workers->parallelFor(nbands, encode_band);
+	} else {
+		for (int band=0; band<nbands; band++) {
+			encode_band(band);
 		}
 	}
-	return true;
+
+	size_t total = out.size();
+	for (int band=0; band<nbands; band++) {
+		total += bands[band].size();
+	}
+	out.reserve(total);
+	for (int band=0; band<nbands; band++) {
+		out.insert(out.end(), bands[band].begin(), bands[band].end());
+	}
 }
 
 TGAColor TGAImage::get(int x, int y) {
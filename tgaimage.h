@@ -1,7 +1,10 @@
 #ifndef __IMAGE_H__
 #define __IMAGE_H__
 
+#include <cstddef>
 #include <fstream>
+#include <vector>
+#include "threadpool.h"
 
 #pragma pack(push,1)
 struct TGA_Header {
@@ -62,7 +65,7 @@ struct TGAColor {
 		return TGAColor((float)r * intensity, (float)g * intensity, (float)b * intensity, a);
 	}
 
-	bool operator ==(const TGAColor &c) {
+	bool operator ==(const TGAColor &c) const {
 		return val == c.val;
 	}
 };
@@ -75,18 +78,38 @@ protected:
 	int height;
 	int bytespp;
 
-	bool   load_rle_data(std::ifstream &in);
-	bool unload_rle_data(std::ofstream &out);
+	// Expands the RLE packets in src, size bytes long, into data
+	bool decode_rle_data(const unsigned char *src, size_t size);
+	// Appends the RLE packets of the whole image to out, the bands spread across workers when there are any
+	void encode_rle_data(std::vector<unsigned char> &out, ThreadPool *workers) const;
+	void encode_tga(std::vector<unsigned char> &out, bool rle=true, ThreadPool *workers=NULL) const;
+	void encode_qoi(std::vector<unsigned char> &out) const;
+	void encode_ppm(std::vector<unsigned char> &out) const;
+	void encode_pam(std::vector<unsigned char> &out) const;
 public:
 	enum Format {
 		GRAYSCALE=1, RGB=3, RGBA=4
 	};
+	// File formats the image can be written as
+	enum FileFormat {
+		TGA_FILE, QOI_FILE, PPM_FILE, PAM_FILE
+	};
+	// Scanlines per band of the parallel RLE encoder
+	static const int RLE_BAND_ROWS = 64;
 
 	TGAImage();
 	TGAImage(int w, int h, int bpp);
 	TGAImage(const TGAImage &img);
 	bool read_tga_file(const char *filename);
-	bool write_tga_file(const char *filename, bool rle=true);
+	bool write_tga_file(const char *filename, bool rle=true, ThreadPool *workers=NULL);
+	// Appends the whole file in the given format to out. The TGA encoder runs on workers when it is given
+	// one, the caller picks a pool nothing else is using at the same time
+	void encode(FileFormat format, std::vector<unsigned char> &out, ThreadPool *workers=NULL) const;
+	bool write_file(const char *filename, FileFormat format, ThreadPool *workers=NULL);
+	static bool write_buffer(const char *filename, const std::vector<unsigned char> &buffer);
+	// Picked from the extension of filename (tga, qoi, ppm or pam), fallback when it is none of them
+	static FileFormat format_from_filename(const char *filename, FileFormat fallback);
+	static const char *format_extension(FileFormat format);
 	bool flip_horizontally();
 	bool flip_vertically();
 	bool scale(int w, int h);
@@ -0,0 +1,74 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(int threads) : task(nullptr), totalTasks(0), nextTask(0), busyWorkers(0), generation(0), stopping(false) {
+	if (threads <= 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (int i=1; i<threads; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (size_t i=0; i<workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+int ThreadPool::getTotalThreads() {
+	return (int)workers.size() + 1;
+}
+
+void ThreadPool::runTasks() {
+	for (int i = nextTask++; i < totalTasks; i = nextTask++) {
+		(*task)(i);
+	}
+}
+
+void ThreadPool::workerLoop() {
+	unsigned int seenGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wakeUp.wait(guard, [&] { return stopping || generation != seenGeneration; });
+			if (stopping) {
+				return;
+			}
+			seenGeneration = generation;
+		}
+		runTasks();
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			busyWorkers--;
+		}
+		finished.notify_one();
+	}
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+	if (workers.empty() || count <= 1) {
+		for (int i=0; i<count; i++) {
+			task(i);
+		}
+		return;
+	}
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		this->task = &task;
+		totalTasks = count;
+		nextTask = 0;
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	wakeUp.notify_all();
+	// The calling thread works too instead of just waiting
+	runTasks();
+	std::unique_lock<std::mutex> guard(lock);
+	finished.wait(guard, [&] { return busyWorkers == 0; });
+	this->task = nullptr;
+}
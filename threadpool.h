@@ -0,0 +1,37 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent set of worker threads, created once and reused for every parallel loop
+// so the per frame cost is just waking them up
+class ThreadPool {
+private:
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wakeUp;
+	std::condition_variable finished;
+	const std::function<void(int)>* task;
+	int totalTasks;
+	std::atomic<int> nextTask;
+	int busyWorkers;
+	unsigned int generation;
+	bool stopping;
+
+	void workerLoop();
+	void runTasks();
+public:
+	// threads <= 0 means one thread per hardware core, the calling thread counts as one of them
+	ThreadPool(int threads=0);
+	~ThreadPool();
+	int getTotalThreads();
+	// Calls task(i) for every i in [0, count) spread across the threads, returns when all of them are done
+	void parallelFor(int count, const std::function<void(int)>& task);
+};
+
+#endif //__THREADPOOL_H__